@@ -0,0 +1,11 @@
+# The application in DataViewer/ and its benchmark in DataViewer/bench/.
+# Either can also be built on its own from its .pro file.
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    app \
+    bench
+
+app.subdir = DataViewer
+bench.subdir = DataViewer/bench
@@ -11,17 +11,17 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = DataViewer
 TEMPLATE = app
 
+include(dataviewer.pri)
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-    graphview.cpp \
-    tablemodel.cpp
+    fileloader.cpp \
+    filetailer.cpp \
+    batchprocessor.cpp
 
 HEADERS  += mainwindow.h \
-    graphview.h \
-    tablemodel.h
+    fileloader.h \
+    filetailer.h \
+    batchprocessor.h
 
 FORMS    += mainwindow.ui
-
-RESOURCES += \
-    graphview.qrc
@@ -0,0 +1,288 @@
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImage>
+#include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
+#include <cstdio>
+
+#include "batchprocessor.h"
+#include "tablemodel.h"
+#include "spectrumfile.h"
+#include "plotrenderer.h"
+
+// one input file on the pool
+class BatchTask : public QRunnable
+{
+public:
+    BatchTask(BatchProcessor *batch, const QString &fileName) :
+        batch(batch), fileName(fileName) {};
+    void run() { batch->process(fileName); };
+
+private:
+    BatchProcessor *batch;
+    QString fileName;
+};
+
+static double megabytesPerSecond(qint64 bytes, qint64 nsecs)
+{
+    return nsecs > 0 ? bytes / 1048576.0 / (nsecs / 1e9) : 0;
+}
+
+BatchProcessor::BatchProcessor() :
+    imageSize(1200, 800), out(stdout), failures(0), totalRows(0), totalBytes(0)
+{
+}
+
+bool BatchProcessor::isCommand(const QString &argument)
+{
+    return argument == "convert" || argument == "stats" || argument == "render";
+}
+
+int BatchProcessor::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::tr("Converts, summarizes and renders spectra without a window."));
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", QObject::tr("convert, stats or render"));
+    parser.addPositionalArgument("files", QObject::tr("Csv or spectrum files, or directories of them"), "files...");
+    QCommandLineOption toOption(QStringList() << "t" << "to",
+                                QObject::tr("Format to convert to, csv or %1.").arg(SpectrumFile::suffix()),
+                                "format", SpectrumFile::suffix());
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    QObject::tr("Directory for the written files, next to the input by default."),
+                                    "directory");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size",
+                                  QObject::tr("Image size of render, WIDTHxHEIGHT."), "size", "1200x800");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  QObject::tr("Number of files processed at once, all cores by default."), "n");
+    parser.addOption(toOption);
+    parser.addOption(outputOption);
+    parser.addOption(sizeOption);
+    parser.addOption(jobsOption);
+    parser.process(arguments);
+
+    QStringList positional = parser.positionalArguments();
+    if (positional.size() < 2 || !isCommand(positional.first()))
+    {
+        std::fprintf(stderr, "%s", qPrintable(parser.helpText()));
+        return 2;
+    }
+    command = positional.takeFirst();
+
+    format = parser.value(toOption).toLower();
+    if (format != "csv" && format != SpectrumFile::suffix())
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(QObject::tr("Unknown format %1").arg(format)));
+        return 2;
+    }
+    QStringList size = parser.value(sizeOption).split('x');
+    if (size.size() != 2 || size.at(0).toInt() < 4 * PlotRenderer::Margin
+            || size.at(1).toInt() < 4 * PlotRenderer::Margin)
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(QObject::tr("Invalid image size %1").arg(parser.value(sizeOption))));
+        return 2;
+    }
+    imageSize = QSize(size.at(0).toInt(), size.at(1).toInt());
+    outputDir = parser.value(outputOption);
+    if (!outputDir.isEmpty() && !QDir().mkpath(outputDir))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(QObject::tr("Cannot create %1").arg(outputDir)));
+        return 2;
+    }
+
+    // directories stand for the data files in them
+    QStringList files;
+    QStringList filters;
+    filters << "*.csv" << "*." + SpectrumFile::suffix();
+    foreach (const QString &path, positional)
+    {
+        if (QFileInfo(path).isDir())
+        {
+            QDir dir(path);
+            foreach (const QString &name, dir.entryList(filters, QDir::Files, QDir::Name))
+                files.append(dir.filePath(name));
+        }
+        else
+        {
+            files.append(path);
+        }
+    }
+
+    palette = QGuiApplication::palette();
+    font = QGuiApplication::font();
+
+    QThreadPool pool;
+    if (parser.isSet(jobsOption))
+        pool.setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+
+    QElapsedTimer timer;
+    timer.start();
+    foreach (const QString &fileName, files)
+        pool.start(new BatchTask(this, fileName));
+    pool.waitForDone();
+    qint64 nsecs = timer.nsecsElapsed();
+
+    print(QObject::tr("%1 files, %2 failed, %3 rows, %4 MB in %5 s with %6 threads: %7 files/s, %8 MB/s")
+          .arg(files.size()).arg(failures).arg(totalRows)
+          .arg(totalBytes / 1048576.0, 0, 'f', 1)
+          .arg(nsecs / 1e9, 0, 'f', 3)
+          .arg(pool.maxThreadCount())
+          .arg(nsecs > 0 ? files.size() / (nsecs / 1e9) : 0, 0, 'f', 1)
+          .arg(megabytesPerSecond(totalBytes, nsecs), 0, 'f', 1));
+    return failures > 0 ? 1 : 0;
+}
+
+void BatchProcessor::process(const QString &fileName)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const qint64 bytes = QFileInfo(fileName).size();
+    TableModel model;
+    QString report;
+    bool ok = model.loadFile(fileName);
+    if (!ok)
+        report = model.errorString();
+    else if (command == "convert")
+        ok = convert(&model, fileName, report);
+    else if (command == "stats")
+        stats(&model, report);
+    else if (command == "render")
+        ok = render(&model, fileName, report);
+    qint64 nsecs = timer.nsecsElapsed();
+
+    QString line;
+    if (ok)
+    {
+        line = QObject::tr("%1: %2 rows in %3 ms, %4 MB/s")
+                .arg(fileName).arg(model.rowCount())
+                .arg(nsecs / 1e6, 0, 'f', 1)
+                .arg(megabytesPerSecond(bytes, nsecs), 0, 'f', 1);
+    }
+    else
+    {
+        line = QObject::tr("%1: failed").arg(fileName);
+    }
+    if (!report.isEmpty())
+        line += "\n    " + report;
+
+    QMutexLocker locker(&outputMutex);
+    if (ok)
+    {
+        totalRows += model.rowCount();
+        totalBytes += bytes;
+    }
+    else
+    {
+        ++failures;
+    }
+    out << line << endl;
+}
+
+bool BatchProcessor::convert(TableModel *model, const QString &fileName, QString &report)
+{
+    QString target = outputFile(fileName, format);
+    if (QFileInfo(target).absoluteFilePath() == QFileInfo(fileName).absoluteFilePath())
+    {
+        report = QObject::tr("%1 would be overwritten").arg(target);
+        return false;
+    }
+    if (!model->saveFile(target))
+    {
+        report = QObject::tr("cannot write %1: %2").arg(target).arg(model->errorString());
+        return false;
+    }
+    report = QObject::tr("written to %1").arg(target);
+    return true;
+}
+
+// energy range, then sum, min, max with the energy of the peak, and mean
+// of every count column
+void BatchProcessor::stats(const TableModel *model, QString &report) const
+{
+    const ColumnSpan<double> energies = model->column1();
+    double minX, maxX;
+    model->column1Range(minX, maxX);
+    report = QObject::tr("%1 %2 .. %3")
+            .arg(model->headerData(0, Qt::Horizontal, Qt::DisplayRole).toString())
+            .arg(minX).arg(maxX);
+    if (model->duplicateCount() > 0)
+        report += QObject::tr(", %1 duplicate energies").arg(model->duplicateCount());
+
+    // a block of rows at a time, packed columns are unpacked block by block
+    const int rows = model->rowCount();
+    const int blockSize = 4096;
+    QVector<unsigned int> buffer(blockSize);
+    for (int series = 0; series < model->countColumnCount(); ++series)
+    {
+        quint64 sum = 0;
+        int peak = 0;
+        unsigned int peakCount = 0;
+        for (int first = 0; first < rows; first += blockSize)
+        {
+            const int last = qMin(first + blockSize, rows);
+            const unsigned int *counts = model->countRows(series, first, last, buffer.data());
+            for (int i = 0; i < last - first; ++i)
+            {
+                sum += counts[i];
+                if (counts[i] > peakCount)
+                {
+                    peak = first + i;
+                    peakCount = counts[i];
+                }
+            }
+        }
+        unsigned int minY, maxY;
+        model->countRange(series, 0, rows, minY, maxY);
+        report += QObject::tr("\n    %1: sum %2, min %3, max %4 at %5, mean %6")
+                .arg(model->headerData(series + 1, Qt::Horizontal, Qt::DisplayRole).toString())
+                .arg(sum).arg(minY).arg(maxY).arg(energies[peak])
+                .arg(rows == 0 ? 0 : double(sum) / rows);
+    }
+}
+
+// the full data range, drawn as GraphView shows it before zooming
+bool BatchProcessor::render(const TableModel *model, const QString &fileName, QString &report)
+{
+    QString target = outputFile(fileName, "png");
+    PlotSettings settings = PlotRenderer::dataExtents(model);
+    settings.adjust();
+
+    PlotRenderer renderer;
+    renderer.setModel(model);
+    renderer.setPalette(palette);
+
+    QImage image(imageSize, QImage::Format_RGB32);
+    image.fill(palette.dark().color());
+    QPainter painter(&image);
+    painter.setFont(font);
+    const int margin = PlotRenderer::Margin;
+    renderer.render(&painter, QRect(margin, margin, image.width() - 2 * margin, image.height() - 2 * margin),
+                    settings);
+    painter.end();
+
+    if (!image.save(target, "PNG"))
+    {
+        report = QObject::tr("cannot write %1").arg(target);
+        return false;
+    }
+    report = QObject::tr("rendered to %1").arg(target);
+    return true;
+}
+
+QString BatchProcessor::outputFile(const QString &fileName, const QString &suffix) const
+{
+    QFileInfo info(fileName);
+    QDir dir = outputDir.isEmpty() ? info.dir() : QDir(outputDir);
+    return dir.filePath(info.completeBaseName() + "." + suffix);
+}
+
+void BatchProcessor::print(const QString &text)
+{
+    QMutexLocker locker(&outputMutex);
+    out << text << endl;
+}
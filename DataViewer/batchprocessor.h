@@ -0,0 +1,56 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QFont>
+#include <QMutex>
+#include <QPalette>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+class TableModel;
+
+// Headless mode for processing jobs, no window is created:
+//
+//   DataViewer convert --to dvs [-o dir] files or directories...
+//   DataViewer stats files or directories...
+//   DataViewer render [--size 1200x800] [-o dir] files or directories...
+//
+// Files are loaded through TableModel and processed in parallel on a
+// thread pool, one file per task. A line is printed per file as it
+// finishes, with its throughput, and a total at the end.
+class BatchProcessor
+{
+public:
+    BatchProcessor();
+
+    static bool isCommand(const QString &argument);
+    // returns the exit code
+    int run(const QStringList &arguments);
+
+    // one file, called from the pool threads
+    void process(const QString &fileName);
+
+private:
+    bool convert(TableModel *model, const QString &fileName, QString &report);
+    void stats(const TableModel *model, QString &report) const;
+    bool render(const TableModel *model, const QString &fileName, QString &report);
+    QString outputFile(const QString &fileName, const QString &suffix) const;
+    void print(const QString &text);
+
+    QString command;
+    QString format;         // of convert
+    QString outputDir;      // empty: next to the input
+    QSize imageSize;        // of render
+    QPalette palette;       // taken in the main thread, only read by the tasks
+    QFont font;
+
+    QMutex outputMutex;     // guards out and the totals
+    QTextStream out;
+    int failures;
+    qint64 totalRows;
+    qint64 totalBytes;
+};
+
+#endif // BATCHPROCESSOR_H
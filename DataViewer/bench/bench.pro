@@ -0,0 +1,13 @@
+# QTest benchmark of DataViewer, see tst_bench.cpp. Machine readable
+# results: ./bench -o results.csv,csv
+
+QT       += core gui widgets testlib
+
+TARGET = bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../dataviewer.pri)
+
+SOURCES += tst_bench.cpp
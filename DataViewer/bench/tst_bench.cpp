@@ -0,0 +1,713 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QImage>
+#include <QKeyEvent>
+#include <QMap>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <QtTest>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+#include "graphview.h"
+#include "pixeltransform.h"
+#include "plotrenderer.h"
+#include "spectrumfile.h"
+#include "tabledisplaymodel.h"
+#include "tablemodel.h"
+
+// Timings of the main code paths on synthetic spectra of 1000, 100000 and
+// 1000000 rows:
+//
+//   bench [-median 5] [-o results.csv,csv] [function[:tag]...]
+//   bench generate --rows 1000000 [--counts 1] [--shuffle] file.csv|file.dvs
+//
+// Cases that change the model time a single run on a freshly prepared
+// one, -median repeats them. The second form writes the same spectra to
+// a file.
+
+// xorshift64*, uniform in [0, 1)
+static double nextRandom(quint64 &state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (state * Q_UINT64_C(2685821657736338717) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static QStringList generatedHeader(int countColumns)
+{
+    QStringList header;
+    header << "Energy (keV)";
+    if (countColumns == 1)
+        header << "Counts";
+    for (int i = 0; countColumns > 1 && i < countColumns; ++i)
+        header << QString("Counts %1").arg(i + 1);
+    return header;
+}
+
+// energies over 0..3000 keV and counts of a few peaks on a falling
+// background with noise; the same rows for the same arguments
+static void generate(int rows, int countColumns, bool shuffle, ColumnBlock &data)
+{
+    static const double peaks[4][2] = {
+        { 661.7, 1000 }, { 1173.2, 400 }, { 1332.5, 350 }, { 1460.8, 200 }
+    };
+    data = ColumnBlock(countColumns);
+    data.column1.resize(rows);
+    for (int series = 0; series < countColumns; ++series)
+        data.counts[series].resize(rows);
+
+    quint64 state = Q_UINT64_C(0x2545F4914F6CDD1D);
+    const double step = 3000.0 / qMax(rows, 1);
+    for (int i = 0; i < rows; ++i)
+    {
+        const double energy = i * step;
+        double expected = 50 * std::exp(-energy / 400);
+        for (int peak = 0; peak < 4; ++peak)
+        {
+            const double sigma = 0.5 + 0.001 * peaks[peak][0];
+            const double distance = (energy - peaks[peak][0]) / sigma;
+            expected += peaks[peak][1] * std::exp(-0.5 * distance * distance);
+        }
+        data.column1[i] = energy;
+
+        // roughly poisson: gaussian noise from the sum of four uniforms
+        for (int series = 0; series < countColumns; ++series)
+        {
+            const double mean = expected / (series + 1);
+            const double noise = (nextRandom(state) + nextRandom(state) + nextRandom(state)
+                                  + nextRandom(state) - 2) * std::sqrt(3.0);
+            data.counts[series][i] = (unsigned int)qMax(0.0, std::floor(mean + std::sqrt(mean) * noise + 0.5));
+        }
+    }
+
+    for (int i = rows - 1; shuffle && i > 0; --i)
+    {
+        const int j = int(nextRandom(state) * (i + 1));
+        std::swap(data.column1[i], data.column1[j]);
+        for (int series = 0; series < countColumns; ++series)
+            std::swap(data.counts[series][i], data.counts[series][j]);
+    }
+}
+
+static int generateFile(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::tr("Writes a synthetic spectrum."));
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", QObject::tr("generate"));
+    parser.addPositionalArgument("file", QObject::tr("Csv or %1 file").arg(SpectrumFile::suffix()));
+    QCommandLineOption rowsOption(QStringList() << "r" << "rows", QObject::tr("Row count."), "rows", "1000000");
+    QCommandLineOption countsOption(QStringList() << "c" << "counts",
+                                    QObject::tr("Number of count columns."), "n", "1");
+    QCommandLineOption shuffleOption("shuffle", QObject::tr("Write the rows in random order."));
+    parser.addOption(rowsOption);
+    parser.addOption(countsOption);
+    parser.addOption(shuffleOption);
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    const int rows = parser.value(rowsOption).toInt();
+    if (positional.size() != 2 || rows <= 0)
+    {
+        std::fprintf(stderr, "%s", qPrintable(parser.helpText()));
+        return 2;
+    }
+    const int countColumns = qMax(1, parser.value(countsOption).toInt());
+    ColumnBlock data;
+    generate(rows, countColumns, parser.isSet(shuffleOption), data);
+
+    // filled like a progressive load, without the sort of endLoading()
+    TableModel model;
+    model.beginLoading(generatedHeader(countColumns), rows);
+    model.appendRows(data);
+    if (!model.saveFile(positional.at(1)))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(model.errorString()));
+        return 1;
+    }
+    return 0;
+}
+
+// frames are drawn on the render thread, a case ends when the last
+// requested one is on screen
+static void waitForFrame(GraphView *graph)
+{
+    QCoreApplication::processEvents();
+    while (!graph->isFrameCurrent())
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+}
+
+// the model filled with rows as a load would, sorted by endLoading()
+static void fill(TableModel &model, const ColumnBlock &rows, bool sort = true)
+{
+    model.beginLoading(generatedHeader(rows.counts.size()), rows.size());
+    model.appendRows(rows);
+    if (sort)
+        model.endLoading();
+}
+
+class BenchDataViewer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void loadFile_data();
+    void loadFile();
+    void saveFile_data();
+    void saveFile();
+    void sortByColumn1_data();
+    void sortByColumn1();
+    void pasteRows_data();
+    void pasteRows();
+    void removeRowSet_data();
+    void removeRowSet();
+
+    void data_data();
+    void data();
+    void getData_data();
+    void getData();
+    void displayData_data();
+    void displayData();
+    void rowLookup_data();
+    void rowLookup();
+    void packCounts_data();
+    void packCounts();
+
+    void pixelTransform_data();
+    void pixelTransform();
+    void plotRender_data();
+    void plotRender();
+    void updateAllData_data();
+    void updateAllData();
+    void zoomPan_data();
+    void zoomPan();
+    void cursorReadout_data();
+    void cursorReadout();
+
+private:
+    static void addRows(const QString &detail = QString());
+    // the generated rows in order, made once per row count
+    const ColumnBlock &rows(int count);
+    // rows written once to a file of the suffix
+    QString file(int count, const QString &suffix);
+
+    QTemporaryDir directory;
+    QMap<int, ColumnBlock> generated;
+};
+
+void BenchDataViewer::initTestCase()
+{
+    QVERIFY(directory.isValid());
+}
+
+// one row per row count, with a detail column if given
+void BenchDataViewer::addRows(const QString &detail)
+{
+    static const int counts[] = { 1000, 100000, 1000000 };
+    for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    {
+        const QString tag = detail.isEmpty() ? QString::number(counts[i])
+                                             : QString("%1 %2").arg(detail).arg(counts[i]);
+        QTest::newRow(qPrintable(tag)) << counts[i] << detail;
+    }
+}
+
+const ColumnBlock &BenchDataViewer::rows(int count)
+{
+    if (!generated.contains(count))
+        generate(count, 1, false, generated[count]);
+    return generated[count];
+}
+
+QString BenchDataViewer::file(int count, const QString &suffix)
+{
+    const QString fileName = QDir(directory.path()).filePath(QString("bench%1.%2").arg(count).arg(suffix));
+    if (!QFile::exists(fileName))
+    {
+        TableModel model;
+        fill(model, rows(count));
+        if (!model.saveFile(fileName))
+            qWarning("%s", qPrintable(model.errorString()));
+    }
+    return fileName;
+}
+
+// the csv file through the mapped reader and, for comparison, line by
+// line through a QTextStream
+void BenchDataViewer::loadFile_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    addRows("csv");
+    addRows("csv QTextStream");
+    addRows(SpectrumFile::suffix());
+}
+
+void BenchDataViewer::loadFile()
+{
+    QFETCH(int, count);
+    QFETCH(QString, detail);
+    const QString fileName = file(count, detail.section(' ', 0, 0));
+    if (detail.endsWith(" QTextStream"))
+    {
+        QBENCHMARK
+        {
+            QFile input(fileName);
+            QVERIFY(input.open(QIODevice::ReadOnly | QIODevice::Text));
+            QTextStream in(&input);
+            TableModel model;
+            QVERIFY(model.loadFile(in));
+        }
+        return;
+    }
+    QBENCHMARK
+    {
+        TableModel model;
+        QVERIFY(model.loadFile(fileName));
+    }
+}
+
+void BenchDataViewer::saveFile_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    addRows("csv");
+    addRows(SpectrumFile::suffix());
+}
+
+void BenchDataViewer::saveFile()
+{
+    QFETCH(int, count);
+    QFETCH(QString, detail);
+    TableModel model;
+    fill(model, rows(count));
+    const QString fileName = QDir(directory.path()).filePath(QString("save%1.%2").arg(count).arg(detail));
+    QBENCHMARK
+    {
+        QVERIFY(model.saveFile(fileName));
+    }
+}
+
+// endLoading() sorts the rows, which arrive in order, nearly in order or
+// in random order
+void BenchDataViewer::sortByColumn1_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    addRows("sorted");
+    addRows("nearly sorted");
+    addRows("shuffled");
+}
+
+void BenchDataViewer::sortByColumn1()
+{
+    QFETCH(int, count);
+    QFETCH(QString, detail);
+    ColumnBlock data;
+    if (detail == "shuffled")
+    {
+        generate(count, 1, true, data);
+    }
+    else
+    {
+        data = rows(count);
+        // a few neighbours swapped, which leaves some dozens of sorted runs
+        for (int i = count / 64; detail == "nearly sorted" && i + 1 < count; i += qMax(count / 64, 2))
+        {
+            std::swap(data.column1[i], data.column1[i + 1]);
+            std::swap(data.counts[0][i], data.counts[0][i + 1]);
+        }
+    }
+
+    TableModel model;
+    fill(model, data, false);
+    QBENCHMARK_ONCE
+    {
+        model.endLoading();
+    }
+    QVERIFY(model.isSorted());
+}
+
+// every tenth gap of the table gets a pasted row, spread over the whole
+// table as a paste from a finer scan would be
+void BenchDataViewer::pasteRows_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    addRows();
+}
+
+void BenchDataViewer::pasteRows()
+{
+    QFETCH(int, count);
+    const ColumnBlock &data = rows(count);
+    QString text;
+    for (int i = 0; i + 1 < data.size(); i += 10)
+        text += QString("%1,%2\n").arg((data.column1[i] + data.column1[i + 1]) / 2, 0, 'g', 17)
+                .arg(data.counts[0][i]);
+
+    TableModel model;
+    fill(model, data);
+    QBENCHMARK_ONCE
+    {
+        QVERIFY(model.pasteRows(text));
+    }
+}
+
+// every tenth row removed, as a selection of many separate rows
+void BenchDataViewer::removeRowSet_data()
+{
+    pasteRows_data();
+}
+
+void BenchDataViewer::removeRowSet()
+{
+    QFETCH(int, count);
+    QVector<int> selection;
+    for (int i = 0; i < count; i += 10)
+        selection.append(i);
+
+    TableModel model;
+    fill(model, rows(count));
+    QBENCHMARK_ONCE
+    {
+        QVERIFY(model.removeRowSet(selection));
+    }
+}
+
+// every cell through data(), as the table view reads it
+void BenchDataViewer::data_data()
+{
+    pasteRows_data();
+}
+
+void BenchDataViewer::data()
+{
+    QFETCH(int, count);
+    TableModel model;
+    fill(model, rows(count));
+    const int columns = model.columnCount();
+    double sum = 0;     // keeps the reads from being optimized away
+    QBENCHMARK
+    {
+        for (int row = 0; row < count; ++row)
+            for (int column = 0; column < columns; ++column)
+                sum += model.data(model.index(row, column)).toDouble();
+    }
+    QVERIFY(sum > 0);
+}
+
+void BenchDataViewer::getData_data()
+{
+    pasteRows_data();
+}
+
+void BenchDataViewer::getData()
+{
+    QFETCH(int, count);
+    TableModel model;
+    fill(model, rows(count));
+    const int columns = model.columnCount();
+    double sum = 0;
+    QBENCHMARK
+    {
+        for (int row = 0; row < count; ++row)
+            for (int column = 0; column < columns; ++column)
+                sum += model.getData(row, column).toDouble();
+    }
+    QVERIFY(sum > 0);
+}
+
+// what the table view reads while scrolling: the display window moved to
+// positions spread over the whole table and the display text of a
+// screenful of rows there
+void BenchDataViewer::displayData_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    addRows();
+    addRows("packed");
+}
+
+void BenchDataViewer::displayData()
+{
+    QFETCH(int, count);
+    QFETCH(QString, detail);
+    TableModel model;
+    fill(model, rows(count));
+    model.setCompactCounts(detail == "packed");
+    TableDisplayModel display;
+    display.setSourceModel(&model);
+
+    const int columns = display.columnCount();
+    const int screen = qMin(count, 40);
+    int length = 0;
+    QBENCHMARK
+    {
+        // every screenful is read twice, as for a repaint that follows a scroll
+        for (int step = 0; step < 1000; ++step)
+        {
+            const int top = int(qint64(count - screen) * step / 1000);
+            display.setFirstRow(top);
+            const int first = top - display.firstRow();
+            for (int pass = 0; pass < 2; ++pass)
+                for (int row = first; row < first + screen; ++row)
+                    for (int column = 0; column < columns; ++column)
+                        length += display.data(display.index(row, column)).toString().size();
+        }
+    }
+    QVERIFY(length > 0);
+}
+
+// a million energy to row lookups spread over the spectrum, through the
+// calibration of column1 or by binary search without one
+void BenchDataViewer::rowLookup_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    addRows("calibration");
+    addRows("binary search");
+}
+
+void BenchDataViewer::rowLookup()
+{
+    QFETCH(int, count);
+    QFETCH(QString, detail);
+    TableModel model;
+    fill(model, rows(count));
+    // the model computes an evenly spaced column1, the search needs it stored
+    const QVector<double> &stored = rows(count).column1;
+    const ColumnSpan<double> column = detail == "calibration" ? model.column1()
+                                                              : ColumnSpan<double>(stored.constData(), stored.size());
+    const UniformAxis axis = detail == "calibration" ? model.column1Axis() : UniformAxis();
+    const double first = column[0];
+    const double span = column[column.size() - 1] - first;
+    qint64 sum = 0;
+    QBENCHMARK
+    {
+        for (int i = 0; i < 1000000; ++i)
+            sum += axis.nearestRow(column, first + span * (i % 1000) / 1000);
+    }
+    QVERIFY(sum > 0);
+}
+
+// packing the count columns of the whole model
+void BenchDataViewer::packCounts_data()
+{
+    pasteRows_data();
+}
+
+void BenchDataViewer::packCounts()
+{
+    QFETCH(int, count);
+    TableModel model;
+    fill(model, rows(count));
+    QBENCHMARK_ONCE
+    {
+        model.setCompactCounts(true);
+    }
+    QVERIFY(model.isCompactCounts());
+}
+
+// every row through the coordinate kernel, the points a decimated
+// frame draws come from the same call
+void BenchDataViewer::pixelTransform_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    for (int kernel = PixelTransform::Scalar; kernel <= PixelTransform::Avx2; ++kernel)
+    {
+        if (!PixelTransform::isSupported(PixelTransform::Kernel(kernel)))
+            continue;
+        addRows(PixelTransform::kernelName(PixelTransform::Kernel(kernel)));
+        addRows(PixelTransform::kernelName(PixelTransform::Kernel(kernel)) + " log");
+    }
+}
+
+void BenchDataViewer::pixelTransform()
+{
+    QFETCH(int, count);
+    QFETCH(QString, detail);
+    const ColumnBlock &data = rows(count);
+    PixelTransform::Kernel kernel = PixelTransform::Scalar;
+    for (int k = PixelTransform::Scalar; k <= PixelTransform::Avx2; ++k)
+    {
+        if (detail.startsWith(PixelTransform::kernelName(PixelTransform::Kernel(k))))
+            kernel = PixelTransform::Kernel(k);
+    }
+    const bool logY = detail.endsWith(" log");
+
+    PlotSettings settings;
+    settings.minX = 0;
+    settings.maxX = 3000;
+    settings.minY = 0;
+    settings.maxY = logY ? 6 : 100000;
+    settings.logY = logY;
+    QVector<QPointF> points(data.size());
+
+    // the best kernel is left in use
+    const PixelTransform::Kernel bestKernel = PixelTransform::kernel();
+    PixelTransform::setKernel(kernel);
+    QBENCHMARK
+    {
+        PixelTransform transform(QRect(0, 0, 1280, 800), settings);
+        transform.map(data.column1.constData(), data.counts.at(0).constData(), data.size(), points.data());
+    }
+    PixelTransform::setKernel(bestKernel);
+}
+
+// what the render thread draws for GraphView at a given size, without
+// the frame cache and the thread around it
+void BenchDataViewer::plotRender_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("detail");
+    addRows("640x480");
+    addRows("1280x800");
+    addRows("2560x1440");
+    addRows("1280x800 packed");
+}
+
+void BenchDataViewer::plotRender()
+{
+    QFETCH(int, count);
+    QFETCH(QString, detail);
+    TableModel model;
+    fill(model, rows(count));
+    model.setCompactCounts(detail.endsWith(" packed"));
+
+    const QStringList size = detail.section(' ', 0, 0).split('x');
+    QImage image(size.at(0).toInt(), size.at(1).toInt(), QImage::Format_RGB32);
+    const QPalette palette = QApplication::palette();
+    PlotRenderer renderer;
+    renderer.setModel(&model);
+    renderer.setPalette(palette);
+    PlotSettings settings = PlotRenderer::dataExtents(&model);
+    settings.adjust();
+
+    const int margin = PlotRenderer::Margin;
+    QBENCHMARK
+    {
+        image.fill(palette.dark().color());
+        QPainter painter(&image);
+        renderer.render(&painter, QRect(margin, margin, image.width() - 2 * margin,
+                                        image.height() - 2 * margin), settings);
+    }
+}
+
+// the repaint that follows a change of the data, through GraphView and
+// its render thread
+void BenchDataViewer::updateAllData_data()
+{
+    pasteRows_data();
+}
+
+void BenchDataViewer::updateAllData()
+{
+    QFETCH(int, count);
+    TableModel model;
+    fill(model, rows(count));
+    GraphView graph;
+    graph.resize(1280, 800);
+    graph.setModel(&model);
+    graph.show();
+    waitForFrame(&graph);
+    QBENCHMARK
+    {
+        graph.updateAllData();
+        waitForFrame(&graph);
+    }
+}
+
+// rubber band zoom, pan around by keys, zoom out again
+void BenchDataViewer::zoomPan_data()
+{
+    pasteRows_data();
+}
+
+void BenchDataViewer::zoomPan()
+{
+    QFETCH(int, count);
+    TableModel model;
+    fill(model, rows(count));
+    GraphView graph;
+    graph.resize(1280, 800);
+    graph.setModel(&model);
+    graph.show();
+    waitForFrame(&graph);
+
+    const QPoint topLeft(graph.width() / 4, graph.height() / 4);
+    const QPoint bottomRight(graph.width() * 3 / 4, graph.height() * 3 / 4);
+    static const int keys[] = { Qt::Key_Right, Qt::Key_Right, Qt::Key_Up, Qt::Key_Left,
+                                Qt::Key_Left, Qt::Key_Down, Qt::Key_Right };
+    QBENCHMARK
+    {
+        QMouseEvent press(QEvent::MouseButtonPress, topLeft, Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+        QMouseEvent move(QEvent::MouseMove, bottomRight, Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+        QMouseEvent release(QEvent::MouseButtonRelease, bottomRight, Qt::LeftButton, Qt::NoButton, Qt::NoModifier);
+        QCoreApplication::sendEvent(&graph, &press);
+        QCoreApplication::sendEvent(&graph, &move);
+        QCoreApplication::sendEvent(&graph, &release);
+        for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+        {
+            QKeyEvent key(QEvent::KeyPress, keys[i], Qt::NoModifier);
+            QCoreApplication::sendEvent(&graph, &key);
+        }
+        graph.zoomOut();
+        waitForFrame(&graph);
+    }
+}
+
+// the cursor readout following the mouse across the plot, each move
+// painted before the next, which draws no new frame
+void BenchDataViewer::cursorReadout_data()
+{
+    pasteRows_data();
+}
+
+void BenchDataViewer::cursorReadout()
+{
+    QFETCH(int, count);
+    TableModel model;
+    fill(model, rows(count));
+    GraphView graph;
+    graph.resize(1280, 800);
+    graph.setModel(&model);
+    graph.show();
+    waitForFrame(&graph);
+    graph.setCursorReadout(true);
+
+    const int left = PlotRenderer::Margin, width = graph.width() - 2 * PlotRenderer::Margin;
+    QBENCHMARK
+    {
+        for (int i = 0; i < 200; ++i)
+        {
+            const QPoint pos(left + width * i / 200, graph.height() / 2);
+            QMouseEvent move(QEvent::MouseMove, pos, Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+            QCoreApplication::sendEvent(&graph, &move);
+            QCoreApplication::processEvents();
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // the graph cases show a GraphView, also without a display
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    if (app.arguments().value(1) == "generate")
+        return generateFile(app.arguments());
+
+    BenchDataViewer bench;
+    return QTest::qExec(&bench, argc, argv);
+}
+
+#include "tst_bench.moc"
@@ -0,0 +1,33 @@
+#ifndef COLUMNSPAN_H
+#define COLUMNSPAN_H
+
+// Read-only view of a contiguous column owned by the model.
+// It stays valid until the model data changes, so don't keep it around
+// across model signals.
+// A column the model computes rather than stores is viewed as the values
+// (offset + i * step) / divisor; it has no data(), begin() or end().
+template <typename T>
+class ColumnSpan
+{
+public:
+    ColumnSpan(const T *data=0, int size=0) :
+        mData(data), mSize(size), mOffset(0), mStep(0), mDivisor(1) {};
+    ColumnSpan(T offset, T step, T divisor, int size) :
+        mData(0), mSize(size), mOffset(offset), mStep(step), mDivisor(divisor) {};
+
+    const T *data() const { return mData; };
+    int size() const { return mSize; };
+    bool isEmpty() const { return mSize==0; };
+    bool isComputed() const { return mData==0 && mSize>0; };
+
+    T operator[](int i) const { return mData!=0 ? mData[i] : (mOffset+i*mStep)/mDivisor; };
+    const T *begin() const { return mData; };
+    const T *end() const { return mData+mSize; };
+
+private:
+    const T *mData;
+    int mSize;
+    T mOffset, mStep, mDivisor;
+};
+
+#endif // COLUMNSPAN_H
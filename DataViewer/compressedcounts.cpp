@@ -0,0 +1,131 @@
+#include <cstring>
+
+#include "compressedcounts.h"
+
+// zero words after the packed bits, see at()
+static const int paddingWords = 2;
+
+// bits needed for values up to range
+static quint32 bitsFor(quint32 range)
+{
+    quint32 bits = 0;
+    for (; range != 0; range >>= 1)
+        ++bits;
+    return bits;
+}
+
+CompressedCounts::CompressedCounts() :
+    mSize(0)
+{
+}
+
+CompressedCounts::CompressedCounts(const unsigned int *values, int size) :
+    mSize(0)
+{
+    blocks.reserve((size + BlockSize - 1) >> BlockShift);
+    append(values, size);
+}
+
+void CompressedCounts::appendBlock(const unsigned int *values, int count)
+{
+    unsigned int min = values[0], max = values[0];
+    for (int i = 1; i < count; ++i)
+    {
+        min = qMin(min, values[i]);
+        max = qMax(max, values[i]);
+    }
+
+    Block block;
+    block.base = min;
+    block.bits = bitsFor(max - min);
+    block.offset = quint32(words.size());
+    blocks.append(block);
+    if (block.bits == 0)
+        return;
+
+    // the values one after the other, low bits first
+    quint64 pending = 0;
+    int pendingBits = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        pending |= quint64(values[i] - min) << pendingBits;
+        pendingBits += block.bits;
+        if (pendingBits >= 32)
+        {
+            words.append(quint32(pending));
+            pending >>= 32;
+            pendingBits -= 32;
+        }
+    }
+    if (pendingBits > 0)
+        words.append(quint32(pending));
+}
+
+// a partly filled last block is unpacked and packed again with the new rows
+void CompressedCounts::append(const unsigned int *values, int count)
+{
+    if (count <= 0)
+        return;
+
+    int done = 0;
+    const int partial = mSize & (BlockSize - 1);
+    if (partial != 0)
+    {
+        unsigned int block[BlockSize];
+        decode(mSize - partial, mSize, block);
+        done = qMin(count, int(BlockSize) - partial);
+        std::memcpy(block + partial, values, done * sizeof(unsigned int));
+        words.resize(int(blocks.last().offset));
+        blocks.removeLast();
+        appendBlock(block, partial + done);
+    }
+    else if (mSize > 0)
+    {
+        words.resize(words.size() - paddingWords);
+    }
+
+    for (; done < count; done += BlockSize)
+        appendBlock(values + done, qMin(int(BlockSize), count - done));
+    mSize += count;
+    for (int i = 0; i < paddingWords; ++i)
+        words.append(0);
+}
+
+void CompressedCounts::decode(int first, int last, unsigned int *out) const
+{
+    int row = first;
+    while (row < last)
+    {
+        const Block &block = blocks.at(row >> BlockShift);
+        const int end = qMin((row | (BlockSize - 1)) + 1, last);
+        if (block.bits == 0)
+        {
+            for (; row < end; ++row)
+                *out++ = block.base;
+            continue;
+        }
+
+        const quint32 *blockWords = words.constData() + block.offset;
+        const quint64 mask = (Q_UINT64_C(1) << block.bits) - 1;
+        quint64 bit = quint64(row & (BlockSize - 1)) * block.bits;
+        for (; row < end; ++row, bit += block.bits)
+        {
+            const quint32 *word = blockWords + (bit >> 5);
+            const quint64 pair = word[0] | (quint64(word[1]) << 32);
+            *out++ = unsigned(block.base + ((pair >> (bit & 31)) & mask));
+        }
+    }
+}
+
+QVector<unsigned int> CompressedCounts::toVector() const
+{
+    QVector<unsigned int> values(mSize);
+    decode(0, mSize, values.data());
+    return values;
+}
+
+qint64 CompressedCounts::memorySize() const
+{
+    return qint64(sizeof(*this)) + qint64(blocks.size()) * sizeof(Block)
+            + qint64(words.size()) * sizeof(quint32);
+}
@@ -0,0 +1,58 @@
+#ifndef COMPRESSEDCOUNTS_H
+#define COMPRESSEDCOUNTS_H
+
+#include <QVector>
+
+// A count column packed a block of 256 rows at a time: each block keeps
+// its smallest value and stores the others as differences from it with
+// as many bits as the largest one needs. A run of zeros, or of any equal
+// values, takes no bits at all, and the quiet parts of a spectrum a few
+// bits per row. Every row is still read in O(1) through the block index,
+// and whole blocks are unpacked in one tight loop.
+class CompressedCounts
+{
+public:
+    CompressedCounts();
+    CompressedCounts(const unsigned int *values, int size);
+
+    int size() const { return mSize; };
+    bool isEmpty() const { return mSize == 0; };
+
+    unsigned int at(int row) const
+    {
+        const Block &block = blocks.at(row >> BlockShift);
+        const quint64 bit = quint64(row & (BlockSize - 1)) * block.bits;
+        const quint32 *word = words.constData() + block.offset + (bit >> 5);
+        // words ends in padding, so the second word is there even for the
+        // last value, or for a block without bits at the end
+        const quint64 pair = word[0] | (quint64(word[1]) << 32);
+        return unsigned(block.base + ((pair >> (bit & 31)) & ((Q_UINT64_C(1) << block.bits) - 1)));
+    };
+    unsigned int operator[](int row) const { return at(row); };
+
+    // rows [first, last) into out
+    void decode(int first, int last, unsigned int *out) const;
+    QVector<unsigned int> toVector() const;
+    void append(const unsigned int *values, int count);
+
+    // bytes held by the column and its index
+    qint64 memorySize() const;
+
+private:
+    enum { BlockShift = 8, BlockSize = 1 << BlockShift };
+
+    struct Block
+    {
+        quint32 base;      // smallest value of the block
+        quint32 offset;    // first word of the block in words
+        quint32 bits;      // bits per value, 0 to 32
+    };
+
+    void appendBlock(const unsigned int *values, int count);
+
+    QVector<Block> blocks;
+    QVector<quint32> words;
+    int mSize;
+};
+
+#endif // COMPRESSEDCOUNTS_H
@@ -0,0 +1,369 @@
+#include <QObject>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+#include "csvreader.h"
+#include "tracer.h"
+
+CsvReader::CsvReader() :
+    mapped(0), begin(0), cur(0), end(0),
+    scanPos(0), blockStart(0), blockMask(0), lineNumber(0), columnCount(2)
+{
+}
+
+CsvReader::~CsvReader()
+{
+    close();
+}
+
+bool CsvReader::open(const QString &fileName, qint64 offset)
+{
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(file.errorString());
+
+    qint64 fileSize = qMax<qint64>(file.size() - offset, 0);
+    if (fileSize > 0)
+    {
+        mapped = file.map(offset, fileSize);
+        if (mapped != 0)
+        {
+            begin = reinterpret_cast<const char *>(mapped);
+        }
+        else
+        {
+            // e.g. special files, fall back to one big read
+            file.seek(offset);
+            buffer = file.readAll();
+            begin = buffer.constData();
+            fileSize = buffer.size();
+        }
+    }
+    else
+    {
+        begin = "";
+        fileSize = 0;
+    }
+
+    cur = begin;
+    end = begin + fileSize;
+    lineNumber = 0;
+    resetScan();
+    return true;
+}
+
+void CsvReader::setBuffer(const QByteArray &data)
+{
+    close();
+    buffer = data;
+    begin = cur = buffer.constData();
+    end = begin + buffer.size();
+    lineNumber = 0;
+    resetScan();
+}
+
+void CsvReader::close()
+{
+    if (mapped != 0)
+        file.unmap(mapped);
+    mapped = 0;
+    file.close();
+    buffer.clear();
+    begin = cur = end = 0;
+    resetScan();
+}
+
+void CsvReader::limitToCompleteLines()
+{
+    const char *last = end;
+    while (last > cur && last[-1] != '\n')
+        --last;
+    end = last;
+    resetScan();
+}
+
+bool CsvReader::fail(const QString &message)
+{
+    mErrorString = message;
+    return false;
+}
+
+// read the first line as column names
+bool CsvReader::readHeader(QStringList &header)
+{
+    header.clear();
+
+    // skip utf-8 byte order mark
+    if (end - cur >= 3 && std::memcmp(cur, "\xEF\xBB\xBF", 3) == 0)
+        cur += 3;
+
+    const char *eol = static_cast<const char *>(std::memchr(cur, '\n', end - cur));
+    if (eol == 0)
+        eol = end;
+    const char *last = eol;
+    if (last > cur && last[-1] == '\r')
+        --last;
+
+    header = QString::fromUtf8(cur, int(last - cur)).split(",", QString::SkipEmptyParts);
+    cur = eol < end ? eol + 1 : end;
+    lineNumber = 1;
+    resetScan();
+
+    if (header.size() < 2)
+        return fail(QObject::tr("Line 1: expected at least two columns"));
+    setColumnCount(header.size());
+    return true;
+}
+
+void CsvReader::setColumnCount(int count)
+{
+    columnCount = count;
+    values.resize(count);
+}
+
+int CsvReader::readRows(ColumnBlock &rows, int maxRows)
+{
+    TRACE_SCOPE("CsvReader::readRows");
+    int count = 0;
+    double *values = this->values.data();
+    const int countColumns = columnCount - 1;
+
+    while (count < maxRows && cur < end)
+    {
+        const char *fieldStart = cur;
+        const char *delimiter;
+        int fields = 0;
+        ++lineNumber;
+
+        for (;;)
+        {
+            delimiter = nextDelimiter();
+            bool endOfLine = (delimiter == end || *delimiter == '\n');
+
+            const char *fieldEnd = delimiter;
+            if (endOfLine && fieldEnd > fieldStart && fieldEnd[-1] == '\r')
+                --fieldEnd;
+
+            if (fieldEnd > fieldStart)  // skip empty parts like QString::split does
+            {
+                if (fields == columnCount)
+                {
+                    fail(QObject::tr("Line %1: expected %2 columns").arg(lineNumber).arg(columnCount));
+                    return -1;
+                }
+                // a nan would sort and compare as no number does
+                if (!parseDouble(fieldStart, fieldEnd, values[fields]) || values[fields] != values[fields])
+                {
+                    fail(QObject::tr("Line %1: invalid number \"%2\"").arg(lineNumber)
+                         .arg(QString::fromUtf8(fieldStart, int(fieldEnd - fieldStart))));
+                    return -1;
+                }
+                ++fields;
+            }
+
+            if (endOfLine)
+                break;
+            fieldStart = delimiter + 1;
+        }
+        cur = delimiter < end ? delimiter + 1 : end;
+
+        if (fields == 0)
+            continue;   // blank line
+        if (fields != columnCount)
+        {
+            fail(QObject::tr("Line %1: expected %2 columns").arg(lineNumber).arg(columnCount));
+            return -1;
+        }
+
+        // counts are whole numbers that fit an unsigned int
+        unsigned int value;
+        for (int i = 0; i < countColumns; i++)
+        {
+            if (!toCount(values[i + 1], value))
+            {
+                fail(QObject::tr("Line %1: invalid count \"%2\"").arg(lineNumber).arg(values[i + 1], 0, 'g', 17));
+                return -1;
+            }
+        }
+
+        rows.column1.append(values[0]);
+        for (int i = 0; i < countColumns; i++)
+            rows.counts[i].append((unsigned int)values[i + 1]);
+        ++count;
+    }
+    return count;
+}
+
+// guess the row count from the line length of the first 64k
+int CsvReader::estimatedRowCount() const
+{
+    qint64 remaining = end - cur;
+    qint64 sampleSize = qMin<qint64>(remaining, 64 * 1024);
+    if (sampleSize == 0)
+        return 0;
+
+    qint64 lines = std::count(cur, cur + sampleSize, '\n');
+    if (lines == 0)
+        return 1;
+    return int(qMin<qint64>(remaining * lines / sampleSize + 1, INT_MAX));
+}
+
+void CsvReader::resetScan()
+{
+    scanPos = cur;
+    blockStart = cur;
+    blockMask = 0;
+}
+
+// position of the next ',' or '\n', or end if there is none
+const char *CsvReader::nextDelimiter()
+{
+    for (;;)
+    {
+        if (blockMask != 0)
+        {
+            const char *p = blockStart + countTrailingZeros(blockMask);
+            blockMask &= blockMask - 1;
+            return p;
+        }
+        if (scanPos >= end)
+            return end;
+
+        blockStart = scanPos;
+#ifdef DATAVIEWER_HAVE_SSE2
+        if (end - scanPos >= 16)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(scanPos));
+            const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')),
+                                              _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+            blockMask = (unsigned int)_mm_movemask_epi8(hits);
+            scanPos += 16;
+            continue;
+        }
+#endif
+        // tail of the file, or no sse2
+        int n = int(qMin<qint64>(end - scanPos, 16));
+        for (int i = 0; i < n; i++)
+        {
+            if (scanPos[i] == ',' || scanPos[i] == '\n')
+                blockMask |= 1u << i;
+        }
+        scanPos += n;
+    }
+}
+
+// Exact powers of ten: a double holds them up to 1e22 without rounding
+const double CsvReader::powersOfTen[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// whole numbers only, converting a double out of range is undefined
+bool CsvReader::toCount(double value, unsigned int &count)
+{
+    if (!(value >= 0) || value > double(UINT_MAX) || value != std::floor(value))
+        return false;
+    count = (unsigned int)value;
+    return true;
+}
+
+// Numbers whose digits fit a mantissa of at most 2^53 with a decimal
+// exponent of at most 22 either way (all of our data) are converted with a
+// single correctly rounded multiply or divide, as both operands are exact;
+// anything else goes through Qt's full conversion.
+bool CsvReader::parseDouble(const char *first, const char *last, double &value)
+{
+    while (first < last && (*first == ' ' || *first == '\t'))
+        ++first;
+    while (last > first && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+        --last;
+    if (first == last)
+        return false;
+
+    const char *p = first;
+    bool negative = false;
+    if (*p == '-' || *p == '+')
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool anyDigit = false, truncated = false;
+
+    for (; p < last && unsigned(*p - '0') < 10; ++p)
+    {
+        anyDigit = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + unsigned(*p - '0');
+            if (mantissa != 0)
+                ++digits;
+        }
+        else
+        {
+            ++exponent;
+            truncated = true;
+        }
+    }
+    if (p < last && *p == '.')
+    {
+        for (++p; p < last && unsigned(*p - '0') < 10; ++p)
+        {
+            anyDigit = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + unsigned(*p - '0');
+                if (mantissa != 0)
+                    ++digits;
+                --exponent;
+            }
+            else
+            {
+                truncated = true;
+            }
+        }
+    }
+    if (anyDigit && p < last && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool negativeExponent = false;
+        if (p < last && (*p == '-' || *p == '+'))
+        {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+        if (p == last)
+            return false;
+        int e = 0;
+        for (; p < last && unsigned(*p - '0') < 10; ++p)
+        {
+            if (e < 100000)
+                e = e * 10 + (*p - '0');
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    if (anyDigit && p == last && !truncated
+            && mantissa <= (Q_UINT64_C(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double result = double(mantissa);
+        if (exponent < 0)
+            result /= powersOfTen[-exponent];
+        else
+            result *= powersOfTen[exponent];
+        value = negative ? -result : result;
+        return true;
+    }
+
+    // slow path: long mantissas, huge exponents, inf/nan
+    bool ok = false;
+    value = QByteArray::fromRawData(first, int(last - first)).toDouble(&ok);
+    return ok;
+}
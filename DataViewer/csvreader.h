@@ -0,0 +1,75 @@
+#ifndef CSVREADER_H
+#define CSVREADER_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "tablemodel.h"
+
+// Reads csv files of an energy column and one or more count columns without a per row allocation:
+// the file is memory mapped, delimiters and newlines are located 16 bytes
+// at a time and the numbers are parsed straight from the mapped bytes.
+class CsvReader
+{
+public:
+    CsvReader();
+    ~CsvReader();
+
+    // map the file from offset on, e.g. to read only what was appended
+    bool open(const QString &fileName, qint64 offset = 0);
+    // read text already in memory, e.g. from the clipboard
+    void setBuffer(const QByteArray &data);
+    void close();
+    // ignore a last line that has no newline yet
+    void limitToCompleteLines();
+
+    bool readHeader(QStringList &header);
+    // number of fields per row, set by readHeader; needed when reading without a header
+    void setColumnCount(int count);
+    // append up to maxRows rows, returns the number of rows read or -1 on error;
+    // rows must have one counts vector per column after the first
+    int readRows(ColumnBlock &rows, int maxRows);
+
+    bool atEnd() const { return cur>=end; };
+    qint64 size() const { return end-begin; };
+    qint64 bytesRead() const { return cur-begin; };
+    int estimatedRowCount() const;
+
+    QString errorString() const { return mErrorString; };
+
+    // locale independent number parsing of [first, last)
+    static bool parseDouble(const char *first, const char *last, double &value);
+    // a parsed count as unsigned, false unless it is a whole number in range
+    static bool toCount(double value, unsigned int &count);
+
+    // 1e0 to 1e22, all exact as doubles
+    static const double powersOfTen[23];
+
+private:
+    void resetScan();
+    const char *nextDelimiter();
+    bool fail(const QString &message);
+
+    QFile file;
+    QByteArray buffer;      // used when the file cannot be mapped
+    uchar *mapped;
+
+    const char *begin;
+    const char *cur;
+    const char *end;
+
+    // state of the delimiter scan
+    const char *scanPos;
+    const char *blockStart;
+    unsigned int blockMask;
+
+    int lineNumber;
+    int columnCount;
+    QVector<double> values; // fields of the current line
+    QString mErrorString;
+};
+
+#endif // CSVREADER_H
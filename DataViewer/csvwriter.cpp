@@ -0,0 +1,218 @@
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QVector>
+#include <cmath>
+#include <cstring>
+
+#include "csvreader.h"
+#include "csvwriter.h"
+#include "tracer.h"
+#include "workerthread.h"
+
+// rows per chunk, a few MB of text
+static const int chunkRows = 1 << 18;
+
+char *CsvWriter::formatUnsigned(quint64 value, char *out)
+{
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = char('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0)
+        *out++ = digits[--n];
+    return out;
+}
+
+// Most values come from text with a few decimals. For those the smallest
+// number of decimals d is found for which the integer m = value * 10^d
+// gives value back as m / 10^d; both are exact below 2^53 and 1e22, so
+// this division is what a reader computes for the text of m with d
+// decimals, and the text round trips. Other values go through Qt's
+// shortest conversion.
+char *CsvWriter::formatDouble(double value, char *out)
+{
+    if (value < 0 || (value == 0 && 1 / value < 0))
+    {
+        *out++ = '-';
+        value = -value;
+    }
+
+    const double limit = 9007199254740992.0;   // 2^53
+    for (int decimals = 0; decimals <= 22 && value < limit; ++decimals)
+    {
+        const double scaled = value * CsvReader::powersOfTen[decimals];
+        if (scaled >= limit)
+            break;
+        const double mantissa = std::floor(scaled + 0.5);
+        if (mantissa / CsvReader::powersOfTen[decimals] != value)
+            continue;
+
+        char digits[20];
+        char *end = formatUnsigned(quint64(mantissa), digits);
+        int length = int(end - digits);
+        if (decimals == 0)
+        {
+            std::memcpy(out, digits, length);
+            return out + length;
+        }
+        // integer part, or 0, then the decimals padded with leading zeros
+        int integerDigits = length - decimals;
+        if (integerDigits > 0)
+        {
+            std::memcpy(out, digits, integerDigits);
+            out += integerDigits;
+        }
+        else
+        {
+            *out++ = '0';
+        }
+        *out++ = '.';
+        for (int i = integerDigits; i < 0; ++i)
+            *out++ = '0';
+        const int fractionStart = qMax(integerDigits, 0);
+        std::memcpy(out, digits + fractionStart, length - fractionStart);
+        return out + length - fractionStart;
+    }
+
+    // long mantissas, huge or tiny exponents, inf and nan
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+    QByteArray text = QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+#else
+    QByteArray text = QByteArray::number(value, 'g', 17);
+#endif
+    std::memcpy(out, text.constData(), text.size());
+    return out + text.size();
+}
+
+void CsvWriter::formatRows(const ColumnBlock &rows, int first, int last, QByteArray &out)
+{
+    const int countColumns = rows.counts.size();
+    const int maxRowSize = maxDoubleSize + countColumns * 11 + 1;
+    const int start = out.size();
+    out.resize(start + (last - first) * maxRowSize);
+
+    // a block of rows at a time, unpacked there if a column is packed or computed
+    const int blockRows = 4096;
+    QVector<const unsigned int *> counts(countColumns);
+    QVector<unsigned int> buffer(countColumns * blockRows);
+    double column1Buffer[blockRows];
+
+    char *p = out.data() + start;
+    for (int block = first; block < last; block += blockRows)
+    {
+        const int blockLast = qMin(block + blockRows, last);
+        const double *column1 = rows.column1Rows(block, blockLast, column1Buffer);
+        for (int series = 0; series < countColumns; ++series)
+            counts[series] = rows.countRows(series, block, blockLast, buffer.data() + series * blockRows);
+        for (int row = block; row < blockLast; ++row)
+        {
+            p = formatDouble(column1[row - block], p);
+            for (int series = 0; series < countColumns; ++series)
+            {
+                *p++ = ',';
+                p = formatUnsigned(counts[series][row - block], p);
+            }
+            *p++ = '\n';
+        }
+    }
+    out.resize(int(p - out.constData()));
+}
+
+// one chunk on the pool
+class FormatTask : public QRunnable
+{
+public:
+    FormatTask(const ColumnBlock &rows, int first, int last, QByteArray &out) :
+        rows(rows), first(first), last(last), out(out) {};
+    void run() { CsvWriter::formatRows(rows, first, last, out); };
+
+private:
+    const ColumnBlock &rows;
+    int first, last;
+    QByteArray &out;
+};
+
+// Chunks are formatted a window at a time, one per thread, while the
+// previous window is being written; on a worker thread one after another.
+bool CsvWriter::write(const QString &fileName, const QStringList &header, const ColumnBlock &rows,
+                      QString &errorString)
+{
+    TRACE_SCOPE("CsvWriter::write");
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        errorString = file.errorString();
+        return false;
+    }
+
+    QByteArray headerLine = header.join(",").toUtf8() + '\n';
+    bool ok = file.write(headerLine) == headerLine.size();
+
+    if (isWorkerThread())
+    {
+        // one of several jobs already, the chunks are formatted here
+        QByteArray buffer;
+        for (int first = 0; ok && first < rows.size(); first += chunkRows)
+        {
+            buffer.clear();
+            formatRows(rows, first, qMin(first + chunkRows, rows.size()), buffer);
+            ok = file.write(buffer) == buffer.size();
+        }
+    }
+    else
+    {
+        QThreadPool pool;
+        const int chunks = (rows.size() + chunkRows - 1) / chunkRows;
+        const int window = qMax(1, pool.maxThreadCount());
+        QVector<QByteArray> buffers[2];
+        buffers[0].resize(window);
+        buffers[1].resize(window);
+
+        for (int chunk = 0, turn = 0; ok && chunk < chunks; chunk += window, turn ^= 1)
+        {
+            // the first window is formatted here, later ones while writing the previous
+            const int count = qMin(window, chunks - chunk);
+            if (chunk == 0)
+            {
+                for (int i = 0; i < count; ++i)
+                    pool.start(new FormatTask(rows, i * chunkRows, qMin((i + 1) * chunkRows, rows.size()),
+                                              buffers[turn][i]));
+                pool.waitForDone();
+            }
+
+            const int next = chunk + window;
+            const int nextCount = qMin(window, chunks - next);
+            for (int i = 0; i < nextCount; ++i)
+            {
+                buffers[turn ^ 1][i].clear();
+                pool.start(new FormatTask(rows, (next + i) * chunkRows,
+                                          qMin((next + i + 1) * chunkRows, rows.size()),
+                                          buffers[turn ^ 1][i]));
+            }
+
+            {
+                TRACE_SCOPE("CsvWriter::write chunk");
+                for (int i = 0; ok && i < count; ++i)
+                    ok = file.write(buffers[turn][i]) == buffers[turn][i].size();
+            }
+            pool.waitForDone();
+        }
+    }
+
+    if (!ok)
+    {
+        errorString = file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit())
+    {
+        errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
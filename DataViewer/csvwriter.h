@@ -0,0 +1,31 @@
+#ifndef CSVWRITER_H
+#define CSVWRITER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include "tablemodel.h"
+
+// Writes csv files at disk speed: rows are formatted into large buffers,
+// chunks of a big table in parallel, and written out in a few big writes.
+// The file is written to a temporary file next to it and renamed over
+// the old one when complete, so a crash never leaves half a file behind.
+class CsvWriter
+{
+public:
+    static bool write(const QString &fileName, const QStringList &header, const ColumnBlock &rows,
+                      QString &errorString);
+
+    // append rows [first, last) as csv lines
+    static void formatRows(const ColumnBlock &rows, int first, int last, QByteArray &out);
+
+    // shortest text that reads back as the same double, locale independent;
+    // returns the end of the written characters, at most maxDoubleSize
+    static char *formatDouble(double value, char *out);
+    static char *formatUnsigned(quint64 value, char *out);
+
+    enum { maxDoubleSize = 32 };
+};
+
+#endif // CSVWRITER_H
@@ -0,0 +1,39 @@
+# The model, file and graph code shared by the application and the
+# benchmark in bench/.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/graphview.cpp \
+    $$PWD/tablemodel.cpp \
+    $$PWD/tabledisplaymodel.cpp \
+    $$PWD/csvreader.cpp \
+    $$PWD/csvwriter.cpp \
+    $$PWD/minmaxpyramid.cpp \
+    $$PWD/compressedcounts.cpp \
+    $$PWD/uniformaxis.cpp \
+    $$PWD/spectrumfile.cpp \
+    $$PWD/pixeltransform.cpp \
+    $$PWD/plotrenderer.cpp \
+    $$PWD/renderworker.cpp \
+    $$PWD/tracer.cpp
+
+HEADERS += $$PWD/graphview.h \
+    $$PWD/tablemodel.h \
+    $$PWD/tabledisplaymodel.h \
+    $$PWD/csvreader.h \
+    $$PWD/csvwriter.h \
+    $$PWD/simd.h \
+    $$PWD/columnspan.h \
+    $$PWD/minmaxpyramid.h \
+    $$PWD/compressedcounts.h \
+    $$PWD/uniformaxis.h \
+    $$PWD/spectrumfile.h \
+    $$PWD/pixeltransform.h \
+    $$PWD/plotrenderer.h \
+    $$PWD/renderworker.h \
+    $$PWD/tracer.h \
+    $$PWD/workerthread.h
+
+RESOURCES += \
+    $$PWD/graphview.qrc
@@ -0,0 +1,88 @@
+#include <QElapsedTimer>
+
+#include "fileloader.h"
+#include "csvreader.h"
+#include "spectrumfile.h"
+#include "tracer.h"
+
+FileLoader::FileLoader(QObject *parent) :
+    QObject(parent), activeLoad(0), lastId(0)
+{
+    qRegisterMetaType<ColumnBlock>();
+}
+
+int FileLoader::requestLoad()
+{
+    int id = lastId.fetchAndAddOrdered(1) + 1;
+    activeLoad.store(id);
+    return id;
+}
+
+void FileLoader::cancel()
+{
+    activeLoad.store(0);
+}
+
+void FileLoader::load(int id, const QString &fileName)
+{
+    TRACE_SCOPE("FileLoader::load");
+    if (!isActive(id))
+        return;
+
+    QStringList header;
+    if (SpectrumFile::isSpectrumFile(fileName))
+    {
+        // binary files are mapped and copied in one go
+        ColumnBlock rows;
+        QString errorString;
+        if (!SpectrumFile::read(fileName, header, rows, errorString))
+        {
+            emit failed(id, errorString);
+            return;
+        }
+        emit started(id, header, rows.size());
+        emit rowsReady(id, rows);
+        emit progress(id, 100);
+        emit finished(id, 0);
+        return;
+    }
+
+    CsvReader reader;
+    if (!reader.open(fileName) || !reader.readHeader(header))
+    {
+        emit failed(id, reader.errorString());
+        return;
+    }
+    // a file that is still being written may end in half a line, which
+    // following picks up once it is complete
+    reader.limitToCompleteLines();
+    emit started(id, header, reader.estimatedRowCount());
+
+    // hand rows over a few times per second, so the views keep up
+    // without being flooded by signals
+    const int rowsPerBlock = 16384;
+    const int msPerChunk = 200;
+    QElapsedTimer timer;
+    timer.start();
+
+    const int countColumns = header.size() - 1;
+    ColumnBlock chunk(countColumns);
+    while (!reader.atEnd())
+    {
+        if (!isActive(id))
+            return;     // cancelled, or superseded by another load
+        if (reader.readRows(chunk, rowsPerBlock) < 0)
+        {
+            emit failed(id, reader.errorString());
+            return;
+        }
+        if (timer.elapsed() >= msPerChunk || reader.atEnd())
+        {
+            emit rowsReady(id, chunk);
+            emit progress(id, int(100 * reader.bytesRead() / qMax<qint64>(reader.size(), 1)));
+            chunk = ColumnBlock(countColumns);
+            timer.restart();
+        }
+    }
+    emit finished(id, reader.bytesRead());
+}
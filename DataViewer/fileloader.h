@@ -0,0 +1,45 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QVector>
+
+#include "tablemodel.h"
+
+// Parses a csv file on a worker thread and hands the rows over in chunks,
+// binary spectrum files are handed over at once.
+// Every load has an id; a load stops as soon as it is no longer the
+// active one, so cancelling or starting another load is immediate.
+class FileLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileLoader(QObject *parent = 0);
+
+    // thread safe, called from the GUI thread
+    int requestLoad();
+    void cancel();
+
+signals:
+    void started(int id, const QStringList &header, int estimatedRows);
+    void rowsReady(int id, const ColumnBlock &rows);
+    void progress(int id, int percent);
+    void finished(int id, qint64 bytesRead);
+    void failed(int id, const QString &message);
+
+public slots:
+    // runs on the worker thread, id comes from requestLoad()
+    void load(int id, const QString &fileName);
+
+private:
+    bool isActive(int id) const { return activeLoad.load()==id; };
+
+    QAtomicInt activeLoad;
+    QAtomicInt lastId;
+};
+
+Q_DECLARE_METATYPE(ColumnBlock)
+
+#endif // FILELOADER_H
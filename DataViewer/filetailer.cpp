@@ -0,0 +1,88 @@
+#include <QFileInfo>
+#include <climits>
+
+#include "filetailer.h"
+#include "csvreader.h"
+
+FileTailer::FileTailer(QObject *parent) :
+    QObject(parent), offset(0), columnCount(2)
+{
+    throttle.setSingleShot(true);
+    throttle.setInterval(250);
+    poll.setInterval(2000);
+
+    connect(&watcher, SIGNAL(fileChanged(QString)), this, SLOT(fileChanged()));
+    connect(&throttle, SIGNAL(timeout()), this, SLOT(readIncrement()));
+    connect(&poll, SIGNAL(timeout()), this, SLOT(fileChanged()));
+}
+
+void FileTailer::start(const QString &fileName, qint64 offset, int columnCount)
+{
+    stop();
+    mFileName = fileName;
+    this->offset = offset;
+    this->columnCount = columnCount;
+    watcher.addPath(fileName);
+    poll.start();
+    fileChanged();  // catch up with what was written meanwhile
+}
+
+void FileTailer::stop()
+{
+    if (!watcher.files().isEmpty())
+        watcher.removePaths(watcher.files());
+    throttle.stop();
+    poll.stop();
+    mFileName.clear();
+}
+
+void FileTailer::fileChanged()
+{
+    if (!isActive())
+        return;
+    // writers that replace the file drop it from the watcher
+    if (!watcher.files().contains(mFileName) && QFileInfo(mFileName).exists())
+        watcher.addPath(mFileName);
+    if (!throttle.isActive())
+        throttle.start();
+}
+
+void FileTailer::readIncrement()
+{
+    if (!isActive())
+        return;
+
+    qint64 size = QFileInfo(mFileName).size();
+    if (size == offset)
+        return;
+    if (size < offset)
+    {
+        QString fileName = mFileName;
+        stop();
+        emit failed(tr("%1 was truncated").arg(fileName));
+        return;
+    }
+
+    CsvReader reader;
+    if (!reader.open(mFileName, offset))
+    {
+        stop();
+        emit failed(reader.errorString());
+        return;
+    }
+    reader.limitToCompleteLines();
+    reader.setColumnCount(columnCount);
+
+    ColumnBlock rows(columnCount - 1);
+    rows.reserve(reader.estimatedRowCount());
+    if (reader.readRows(rows, INT_MAX) < 0)
+    {
+        stop();
+        emit failed(reader.errorString());
+        return;
+    }
+    offset += reader.bytesRead();
+
+    if (!rows.isEmpty())
+        emit rowsAppended(rows);
+}
@@ -0,0 +1,42 @@
+#ifndef FILETAILER_H
+#define FILETAILER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QString>
+
+#include "tablemodel.h"
+
+// Follows a csv file that is still being written: only the bytes appended
+// since the last read are parsed, complete lines only, at most a few times
+// per second however often the file changes.
+class FileTailer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileTailer(QObject *parent = 0);
+
+    // offset is the number of bytes already loaded, columnCount the number of fields per row
+    void start(const QString &fileName, qint64 offset, int columnCount);
+    void stop();
+    bool isActive() const { return !mFileName.isEmpty(); };
+
+signals:
+    void rowsAppended(const ColumnBlock &rows);
+    void failed(const QString &message);
+
+private slots:
+    void fileChanged();
+    void readIncrement();
+
+private:
+    QFileSystemWatcher watcher;
+    QTimer throttle;        // bounds the update rate
+    QTimer poll;            // for file systems without change notification
+    QString mFileName;
+    qint64 offset;
+    int columnCount;
+};
+
+#endif // FILETAILER_H
@@ -1,17 +1,38 @@
 #include <QModelIndex>
-#include <cmath>
+#include <QTimer>
+#include <algorithm>
 #include <QStylePainter>
 #include <QStyleOptionFocusRect>
 
 #include "graphview.h"
+#include "pixeltransform.h"
+#include "tracer.h"
 
 GraphView::GraphView(QWidget * parent):
-    QWidget(parent), labelX("labelX"), labelY("labelY")
+    QWidget(parent), model(0), dataVersion(0), frameTimes(200)
 {
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
     setFocusPolicy(Qt::StrongFocus);
 
     rubberBandIsShown = false;
+    refreshScheduled = false;
+    logScale = false;
+    frameTimingVisible = false;
+    frameCount = 0;
+    pointsDrawn = 0;
+    frameId = 0;
+    pendingFrame = 0;
+    pendingVersion = 0;
+    cursorReadout = false;
+    cursorRow = -1;
+    frameCache.setMaxCost(FrameCacheSize);
+
+    worker = new RenderWorker;
+    worker->moveToThread(&renderThread);
+    connect(this, SIGNAL(frameRequested(int,RenderJob)), worker, SLOT(render(int,RenderJob)));
+    connect(worker, SIGNAL(rendered(int,QImage,PlotSettings,int,qint64)),
+            this, SLOT(frameRendered(int,QImage,PlotSettings,int,qint64)));
+    renderThread.start();
 
     zoomInButton = new QToolButton(this);
     zoomInButton->setIcon(QIcon(":/images/zoomin.png"));
@@ -26,6 +47,14 @@ GraphView::GraphView(QWidget * parent):
     setPlotSettings(PlotSettings());
 }
 
+GraphView::~GraphView()
+{
+    worker->cancel();
+    renderThread.quit();
+    renderThread.wait();
+    delete worker;
+}
+
 void GraphView::setPlotSettings(const PlotSettings &settings)
 {
     zoomStack.clear();
@@ -40,73 +69,149 @@ void GraphView::setPlotSettings(const PlotSettings &settings)
 
 void GraphView::setModel(TableModel *model)
 {
+    if(this->model!=NULL)
+        disconnect(this->model, 0, this, 0);
     this->model=model;
+    cursorRow=-1;
 
     connect(model,SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(updateChangedData(QModelIndex ,QModelIndex)));
+    connect(model,SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(updateInsertedData(QModelIndex,int,int)));
+    connect(model,SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(updateRemovedData(QModelIndex,int,int)));
+    connect(model,SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)),
+            this, SLOT(updateMovedData(QModelIndex,int,int,QModelIndex,int)));
     connect(model,SIGNAL(layoutChanged()), this, SLOT(updateAllData()));
+    connect(model,SIGNAL(modelReset()), this, SLOT(resetAllData()));
+    connect(model,SIGNAL(headerDataChanged(Qt::Orientation,int,int)), this, SLOT(updateLabels()));
 
-    labelX=model->headerData(0,Qt::Horizontal,Qt::DisplayRole).toString();
-    labelY=model->headerData(1,Qt::Horizontal,Qt::DisplayRole).toString();
+    // a new data set, start from the full view
+    updateLabels();
+    upDatePlotSettings(true);
 }
 
+// The update slots below only repaint when the plot is affected: when the
+// data bounds behind the current view changed, or when the changed rows
+// (with their neighbours, as the curve connects them) are in view.
+// Repaints of a burst of signals are merged into one. Every change counts
+// as new data, see invalidateFrames().
 
 void GraphView::updateChangedData(QModelIndex topLeft ,QModelIndex bottomRight)
 {
-    for(int j=topLeft.row();j<=bottomRight.row();j++)
-    {
-        if(topLeft.column()==0)
-        {
-            if(j<dataX.size())
-                dataX[j]=model->getData(j,0).toDouble();
-            else
-                dataX.append(model->getData(j,0).toDouble());
-        }
+    invalidateFrames();
+    if (upDatePlotSettings() || rowsVisible(topLeft.row() - 1, bottomRight.row() + 1))
+        scheduleRefresh();
+}
 
-        if(bottomRight.column()>0)
-        {
-            if(j<dataY.size())
-                dataY[j]=model->getData(j,1).toDouble();
-            else
-                dataY.append(model->getData(j,1).toDouble());
-        }
-    }
-    upDatePlotSettings();
+// rows appended while a file is loading, or inserted from the table
+void GraphView::updateInsertedData(const QModelIndex & /* parent */, int first, int last)
+{
+    invalidateFrames();
+    if (upDatePlotSettings() || rowsVisible(first - 1, last + 1))
+        scheduleRefresh();
+}
+
+// the removed rows were between what are now rows first-1 and first
+void GraphView::updateRemovedData(const QModelIndex & /* parent */, int first, int /* last */)
+{
+    invalidateFrames();
+    if (upDatePlotSettings() || rowsVisible(first - 1, first))
+        scheduleRefresh();
 }
 
+// an edited row moved to its sorted position, every row in between shifted
+void GraphView::updateMovedData(const QModelIndex & /* parent */, int first, int last,
+                                const QModelIndex & /* destination */, int row)
+{
+    invalidateFrames();
+    if (upDatePlotSettings() || rowsVisible(qMin(first, row) - 1, qMax(last, row) + 1))
+        scheduleRefresh();
+}
+
+// same data set in a new order, or with many rows merged in or removed
+// at once; the zoom stays
 void GraphView::updateAllData()
 {
-    dataX.clear();
-    dataY.clear();
-    for(int j=0; j<model->rowCount();j++)
+    TRACE_SCOPE("GraphView::updateAllData");
+    invalidateFrames();
+    upDatePlotSettings();
+    scheduleRefresh();
+}
+
+// all rows of the shown model replaced; the zoom stays as for any other
+// change of its data, only a new model starts from the full view
+void GraphView::resetAllData()
+{
+    updateLabels();
+    updateAllData();
+}
+
+// the labels are taken from the headers when the frame is drawn
+void GraphView::updateLabels()
+{
+    invalidateFrames();
+    scheduleRefresh();
+}
+
+// A new data version: no cached frame shows it, and the render thread
+// redraws rather than scrolls the curves.
+void GraphView::invalidateFrames()
+{
+    ++dataVersion;
+    frameCache.clear();
+}
+
+// does the curve through rows [first, last] cross the current view
+bool GraphView::rowsVisible(int first, int last) const
+{
+    const ColumnSpan<double> dataX = model->column1();
+    first = qMax(first, 0);
+    last = qMin(last, dataX.size() - 1);
+    if (first > last)
+        return false;
+    if (!model->isSorted())
+        return true;
+
+    const PlotSettings &settings = zoomStack[curZoom];
+    return dataX[last] >= settings.minX && dataX[first] <= settings.maxX;
+}
+
+// The data bounds come from the model in O(log n). Only when they change
+// is the full view (zoomStack[0]) replaced; the zoom history and the
+// current zoom level are kept unless resetZoom is set.
+// Returns true if the current view changed and needs a repaint.
+bool GraphView::upDatePlotSettings(bool resetZoom)
+{
+    PlotSettings extents = PlotRenderer::dataExtents(model, logScale);
+
+    if(!resetZoom && extents.minX==dataExtents.minX && extents.maxX==dataExtents.maxX
+            && extents.minY==dataExtents.minY && extents.maxY==dataExtents.maxY)
+        return false;
+    dataExtents=extents;
+
+    PlotSettings plotSettings(extents);
+    plotSettings.adjust();
+    if(resetZoom)
     {
-       dataX.append(model->getData(j,0).toDouble());
-       dataY.append(model->getData(j,1).toDouble());
+        setPlotSettings(plotSettings);
+        return true;
     }
-    upDatePlotSettings();
+    zoomStack[0]=plotSettings;
+    return curZoom==0;
 }
 
-void GraphView::upDatePlotSettings()
+// coalesce the repaints of several model signals into one
+void GraphView::scheduleRefresh()
 {
-    double minX,minY,maxX,maxY;
-    if(dataX.size()>0)
+    if (!refreshScheduled)
     {
-        minX=maxX=dataX.first();
-        minY=maxY=dataX.first();
-        for(int j=0; j<dataX.size();j++)
-        {
-            if(minX>dataX[j])
-                minX=dataX[j];
-            if(minY>dataY[j])
-                minY=dataY[j];
-            if(maxX<dataX[j])
-                maxX=dataX[j];
-            if(maxY<dataY[j])
-                maxY=dataY[j];
-        }
+        refreshScheduled = true;
+        QTimer::singleShot(0, this, SLOT(scheduledRefresh()));
     }
-    PlotSettings plotSettings(minX,minY,maxX,maxY);
-    plotSettings.adjust();
-    setPlotSettings(plotSettings);
+}
+
+void GraphView::scheduledRefresh()
+{
+    if (refreshScheduled)
+        refreshPixmap();
 }
 
 void GraphView::zoomOut()
@@ -133,104 +238,244 @@ void GraphView::zoomIn()
     }
 }
 
-void GraphView::clearCurve()
+// Hands the current view to the render thread. Until the frame comes
+// back the last one stays on screen, moved to the new view.
+void GraphView::refreshPixmap()
 {
-    dataX.clear();
-    dataY.clear();
-    refreshPixmap();
+    TRACE_SCOPE("GraphView::refreshPixmap");
+    refreshScheduled = false;
+
+    const PlotSettings &settings = zoomStack[curZoom];
+    if (QImage *cached = frameCache.object(FrameKey(settings, size(), dataVersion)))
+    {
+        // the id of the cached frame outdates those still being drawn
+        frameId = pendingFrame = worker->requestFrame();
+        frame = *cached;
+        frameSettings = settings;
+        update();
+        return;
+    }
+
+    RenderJob job;
+    if (model != NULL)
+        job.data = model->snapshot();
+    job.dataVersion = dataVersion;
+    job.settings = settings;
+    job.size = size();
+    job.palette = palette();
+    job.font = font();
+    pendingFrame = worker->requestFrame();
+    pendingVersion = dataVersion;
+    emit frameRequested(pendingFrame, job);
+    update();
 }
 
-void GraphView::refreshPixmap()
+// frames arrive in request order, so each one is newer than the frame
+// on screen even when a later request is still pending
+void GraphView::frameRendered(int id, const QImage &image, const PlotSettings &settings,
+                              int points, qint64 nsecs)
 {
-    pixmap = QPixmap(size());
-    QPainter painter(&pixmap);
-    painter.initFrom(this);
-    drawGrid(&painter);
-    drawCurves(&painter);
+    if (id < frameId)
+        return;
+    frameId = id;
+    frame = image;
+    frameSettings = settings;
+    pointsDrawn = points;
+    // only the latest frame shows a view the user stopped at, and only
+    // while its data is current
+    if (id == pendingFrame && pendingVersion == dataVersion && !image.isNull())
+        frameCache.insert(FrameKey(settings, image.size(), pendingVersion), new QImage(image),
+                          image.bytesPerLine() * image.height() / 1024);
+
+    frameTimes[frameCount % frameTimes.size()] = nsecs;
+    ++frameCount;
     update();
 }
 
-void GraphView::drawGrid(QPainter *painter)
+// The last frame as it fits the current view: stretched to a new widget
+// size, and its plot area scaled and shifted to where its data range lies
+// now, so panning and zooming respond at once. The margins keep the old
+// axis labels until the new frame is in.
+void GraphView::drawFrame(QPainter *painter)
 {
-    QRect rect(Margin, Margin,
-               width() - 2 * Margin, height() - 2 * Margin);
+    if (frame.isNull())
+    {
+        painter->fillRect(rect(), palette().dark());
+        return;
+    }
+    if (frame.size() == size())
+        painter->drawImage(0, 0, frame);
+    else
+        painter->drawImage(rect(), frame);
 
-    if (!rect.isValid())
+    const PlotSettings &settings = zoomStack[curZoom];
+    if (frameSettings == settings)
         return;
 
-    PlotSettings settings = zoomStack[curZoom];
-    QPen quiteDark = palette().dark().color().light();
-    QPen light = palette().light().color();
-    for (int i = 0; i <= settings.numXTicks; ++i)
-    {
-        int x = rect.left() + (i * (rect.width() - 1)
-                               / settings.numXTicks);
-        double label = settings.minX + (i * settings.spanX()
-                                        / settings.numXTicks);
-        painter->setPen(quiteDark);
-        painter->drawLine(x, rect.top(), x, rect.bottom());
-        painter->setPen(light);
-        painter->drawLine(x, rect.bottom(), x, rect.bottom() + 5);
-        painter->drawText(x - 50, rect.bottom() + 5, 100, 15,
-                          Qt::AlignHCenter | Qt::AlignTop,
-                          QString::number(label));
-    }
+    const QRect plot(Margin, Margin, width() - 2 * Margin, height() - 2 * Margin);
+    const QRect framePlot(Margin, Margin, frame.width() - 2 * Margin, frame.height() - 2 * Margin);
+    if (plot.width() < 2 || plot.height() < 2 || framePlot.width() < 2 || framePlot.height() < 2)
+        return;
+    const double scaleX = (plot.width() - 1) / settings.spanX();
+    const double scaleY = (plot.height() - 1) / settings.spanY();
+    QRectF target(plot.left() + (frameSettings.minX - settings.minX) * scaleX,
+                  plot.bottom() - (frameSettings.maxY - settings.minY) * scaleY,
+                  frameSettings.spanX() * scaleX * framePlot.width() / (framePlot.width() - 1),
+                  frameSettings.spanY() * scaleY * framePlot.height() / (framePlot.height() - 1));
+
+    painter->save();
+    painter->setClipRect(plot);
+    painter->fillRect(plot, palette().dark());
+    painter->drawImage(target, frame, framePlot);
+    painter->restore();
+}
 
-    painter->drawText(rect.center().x(), rect.bottom() + 30,
-                      labelX);
+// the zoom history is in the units of the old axis, so it is dropped
+void GraphView::setLogScale(bool on)
+{
+    if (logScale == on)
+        return;
+    logScale = on;
+    if (model != NULL)
+        upDatePlotSettings(true);
+}
 
-    for (int j = 0; j <= settings.numYTicks; ++j)
+void GraphView::setFrameTimingVisible(bool visible)
+{
+    frameTimingVisible = visible;
+    update();
+}
+
+// last, average and 99th percentile of the render time of the recent
+// frames, drawn over the frame so showing it costs no extra frame
+void GraphView::drawFrameTiming(QPainter *painter)
+{
+    const int frames = qMin(frameCount, frameTimes.size());
+    if (frames == 0)
+        return;
+
+    QVector<qint64> recent = frameTimes.mid(0, frames);
+    std::sort(recent.begin(), recent.end());
+    qint64 sum = 0;
+    for (int i = 0; i < frames; ++i)
+        sum += recent.at(i);
+    const qint64 last = frameTimes.at((frameCount - 1) % frameTimes.size());
+    const qint64 p99 = recent.at(qMin(frames - 1, frames * 99 / 100));
+
+    QString text = tr("frame %1 ms, avg %2 ms, p99 %3 ms, %4 points")
+            .arg(last / 1e6, 0, 'f', 2)
+            .arg(sum / 1e6 / frames, 0, 'f', 2)
+            .arg(p99 / 1e6, 0, 'f', 2)
+            .arg(pointsDrawn);
+    painter->setPen(palette().light().color());
+    painter->drawText(QRect(Margin, 5, width() - 2 * Margin, Margin - 10),
+                      Qt::AlignLeft | Qt::AlignVCenter, text);
+}
+
+void GraphView::setCursorReadout(bool on)
+{
+    cursorReadout = on;
+    setMouseTracking(on);
+    if (!on && hasCursor())
+        update(cursorRegion());
+    if (!on)
+        cursorRow = -1;
+}
+
+// The row nearest to the energy under the mouse, found by the model in
+// O(1) on an evenly spaced energy axis and by binary search otherwise.
+// Only the old and the new crosshair are repainted, over the frame on
+// screen, so the readout follows the mouse without a new frame.
+void GraphView::updateCursor(const QPoint &pos)
+{
+    const QRect plot(Margin, Margin, width() - 2 * Margin, height() - 2 * Margin);
+    int row = -1;
+    if (model != NULL && model->isSorted() && plot.width() > 1 && plot.contains(pos))
     {
-        int y = rect.bottom() - (j * (rect.height() - 1)
-                                 / settings.numYTicks);
-        double label = settings.minY + (j * settings.spanY()
-                                        / settings.numYTicks);
-        painter->setPen(quiteDark);
-        painter->drawLine(rect.left(), y, rect.right(), y);
-        painter->setPen(light);
-        painter->drawLine(rect.left() - 5, y, rect.left(), y);
-        painter->drawText(rect.left() - Margin, y - 10, Margin - 5, 20,
-                          Qt::AlignRight | Qt::AlignVCenter,
-                          QString::number(label));
+        const PlotSettings &settings = zoomStack[curZoom];
+        const double energy = settings.minX + (pos.x() - plot.left()) * settings.spanX() / (plot.width() - 1);
+        row = model->nearestRow(energy);
     }
-    painter->drawRect(rect.adjusted(0, 0, -1, -1));
 
-    // ugly draw label Y
-    painter->translate(rect.left() - 30, rect.center().y());
-    painter->rotate(270);
-    painter->drawText(0,0,labelY);
-    painter->resetTransform();
+    if (hasCursor())
+        update(cursorRegion());
+    const bool moved = row != cursorRow;
+    cursorPos = pos;
+    cursorRow = row;
+    if (hasCursor())
+        update(cursorRegion());
+    if (moved && row >= 0)
+        emit rowHovered(row);
+}
+
+// pixel column of the cursor row in the current view
+int GraphView::cursorX() const
+{
+    const PlotSettings &settings = zoomStack[curZoom];
+    const double scaleX = (width() - 2 * Margin - 1) / settings.spanX();
+    const double x = Margin + (model->column1()[cursorRow] - settings.minX) * scaleX;
+    return qRound(qBound(-1e6, x, 1e6));
 }
 
+QString GraphView::cursorText() const
+{
+    QString text = tr("%1: %2").arg(model->headerData(0, Qt::Horizontal, Qt::DisplayRole).toString())
+            .arg(model->column1()[cursorRow]);
+    for (int series = 0; series < model->countColumnCount(); ++series)
+        text += tr("\n%1: %2").arg(model->headerData(series + 1, Qt::Horizontal, Qt::DisplayRole).toString())
+                .arg(model->count(series, cursorRow));
+    return text;
+}
 
-void GraphView::drawCurves(QPainter *painter)
+// next to the mouse, on the side that keeps it inside the widget
+QRect GraphView::cursorLabelRect() const
 {
-    static const QColor colorForIds[6] = {
-        Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow
-    };
-    PlotSettings settings = zoomStack[curZoom];
-    QRect rect(Margin, Margin,
-               width() - 2 * Margin, height() - 2 * Margin);
-    if (!rect.isValid())
-        return;
+    QRect label = fontMetrics().boundingRect(QRect(0, 0, width(), height()), Qt::AlignLeft, cursorText())
+            .adjusted(-4, -2, 4, 2);
+    QPoint topLeft = cursorPos + QPoint(12, 12);
+    if (topLeft.x() + label.width() > width())
+        topLeft.rx() = cursorPos.x() - 12 - label.width();
+    if (topLeft.y() + label.height() > height())
+        topLeft.ry() = cursorPos.y() - 12 - label.height();
+    label.moveTopLeft(topLeft);
+    return label;
+}
+
+// the vertical line with the markers on it, and the label
+QRegion GraphView::cursorRegion() const
+{
+    QRegion region(cursorLabelRect());
+    return region.united(QRect(cursorX() - 4, Margin, 9, height() - 2 * Margin));
+}
 
-    painter->setClipRect(rect.adjusted(+1, +1, -1, -1));
+void GraphView::drawCursor(QPainter *painter)
+{
+    if (!hasCursor())
+        return;
 
-    QPolygonF polyline(dataX.size());
+    const QRect plot(Margin, Margin, width() - 2 * Margin, height() - 2 * Margin);
+    const PlotSettings &settings = zoomStack[curZoom];
+    const double scaleY = (plot.height() - 1) / settings.spanY();
+    const int x = cursorX();
 
-    for (int j = 0; j < dataX.size(); ++j)
+    painter->save();
+    painter->setClipRect(plot.adjusted(+1, +1, -1, -1));
+    painter->setPen(palette().light().color());
+    painter->drawLine(x, plot.top(), x, plot.bottom());
+    for (int series = 0; series < model->countColumnCount(); ++series)
     {
-         double dx = dataX[j] - settings.minX;
-         double dy = dataY[j] - settings.minY;
-         double pointX = rect.left() + (dx * (rect.width() - 1)
-                                      / settings.spanX());
-         double pointY = rect.bottom() - (dy * (rect.height() - 1)
-                                        / settings.spanY());
-         polyline[j] = QPointF(pointX, pointY);
+        const unsigned int count = model->count(series, cursorRow);
+        const double value = settings.logY ? PixelTransform::countLog(count) : count;
+        const double y = plot.bottom() - (value - settings.minY) * scaleY;
+        painter->drawEllipse(QPointF(x, qBound(-1e6, y, 1e6)), 3, 3);
     }
+    painter->restore();
 
-    painter->setPen(Qt::yellow);
-    painter->drawPolyline(polyline);
+    const QRect label = cursorLabelRect();
+    painter->fillRect(label, palette().dark());
+    painter->setPen(palette().light().color());
+    painter->drawRect(label.adjusted(0, 0, -1, -1));
+    painter->drawText(label.adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignVCenter, cursorText());
 }
 
 QSize GraphView::minimumSizeHint() const
@@ -246,7 +491,7 @@ QSize GraphView::sizeHint() const
 void GraphView::paintEvent(QPaintEvent * /* event */)
 {
     QStylePainter painter(this);
-    painter.drawPixmap(0, 0, pixmap);
+    drawFrame(&painter);
 
     if (rubberBandIsShown)
     {
@@ -254,6 +499,12 @@ void GraphView::paintEvent(QPaintEvent * /* event */)
         painter.drawRect(rubberBandRect.normalized().adjusted(0, 0, -1, -1));
     }
 
+    if (frameTimingVisible)
+        drawFrameTiming(&painter);
+
+    if (cursorReadout && !rubberBandIsShown)
+        drawCursor(&painter);
+
     if (hasFocus())
     {
         QStyleOptionFocusRect option;
@@ -283,6 +534,9 @@ void GraphView::mousePressEvent(QMouseEvent *event)
 
         if (rect.contains(event->pos()))
         {
+            // the readout is hidden while zooming
+            if (hasCursor())
+                update(cursorRegion());
             rubberBandIsShown = true;
             rubberBandRect.setTopLeft(event->pos());
             rubberBandRect.setBottomRight(event->pos());
@@ -304,6 +558,17 @@ void GraphView::mouseMoveEvent(QMouseEvent *event)
         rubberBandRect.setBottomRight(event->pos());
         updateRubberBandRegion();
     }
+    else if (cursorReadout)
+    {
+        updateCursor(event->pos());
+    }
+}
+
+void GraphView::leaveEvent(QEvent * /* event */)
+{
+    if (hasCursor())
+        update(cursorRegion());
+    cursorRow = -1;
 }
 
 void GraphView::mouseReleaseEvent(QMouseEvent *event)
@@ -324,6 +589,7 @@ void GraphView::mouseReleaseEvent(QMouseEvent *event)
 
         PlotSettings prevSettings = zoomStack[curZoom];
         PlotSettings settings;
+        settings.logY = prevSettings.logY;
 
         double dx = prevSettings.spanX() / (width() - 2 * Margin);
         double dy = prevSettings.spanY() / (height() - 2 * Margin);
@@ -397,49 +663,3 @@ void GraphView::updateRubberBandRegion()
     update(rect.left(), rect.bottom(), rect.width(), 1);
     update(rect.right(), rect.top(), 1, rect.height());
 }
-
-PlotSettings::PlotSettings(double minX, double minY, double maxX, double maxY):
-minX(minX), minY(minY), maxX(maxX), maxY(maxY), numXTicks(5), numYTicks(5)
-{
-}
-
-void PlotSettings::scroll(int dx, int dy)
-{
-    double stepX = spanX() / numXTicks;
-    minX += dx * stepX;
-    maxX += dx * stepX;
-    double stepY = spanY() / numYTicks;
-    minY += dy * stepY;
-    maxY += dy * stepY;
-}
-
-void PlotSettings::adjust()
-{
-    adjustAxis(minX, maxX, numXTicks);
-    adjustAxis(minY, maxY, numYTicks);
-}
-
-// ajust Axis to provide a better view
-void PlotSettings::adjustAxis(double &min, double &max,
-                              int &numTicks)
-{
-    const int MinTicks = 4;
-    double grossStep = (max - min) / MinTicks;
-    double step = pow(10.0, floor(log10(grossStep)));
-    if (5 * step < grossStep)
-    {
-        step *= 5;
-    }
-    else if (2 * step < grossStep)
-    {
-        step *= 2;
-    }
-
-    numTicks = int(ceil(max / step) - floor(min / step));
-    if (numTicks < MinTicks)
-        numTicks = MinTicks;
-
-    min = floor(min / step) * step;
-    max = ceil(max / step) * step;
-}
-
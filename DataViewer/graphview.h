@@ -8,76 +8,148 @@
 #include <QToolButton>
 #include <QAbstractItemModel>
 #include <QModelIndexList>
+#include <QCache>
+#include <QThread>
 #include "tablemodel.h"
+#include "plotrenderer.h"
+#include "renderworker.h"
 
-class PlotSettings
+// a rendered frame is identified by the view, the widget size and the
+// version of the data it shows
+class FrameKey
 {
 public:
-    PlotSettings(double minX=0, double minY=0,double maxX=10,double maxY=10);
-    void scroll(int dx, int dy);
-    void adjust();
-    double spanX() const { return maxX - minX; }
-    double spanY() const { return maxY - minY; }
-    double minX, minY, maxX, maxY;
-    int numXTicks, numYTicks;
-private:
-    static void adjustAxis(double &min, double &max, int &numTicks);
+    FrameKey(const PlotSettings &settings, const QSize &size, int dataVersion) :
+        settings(settings), size(size), dataVersion(dataVersion) {};
+    bool operator==(const FrameKey &other) const {
+        return settings == other.settings && size == other.size && dataVersion == other.dataVersion;
+    };
+
+    PlotSettings settings;
+    QSize size;
+    int dataVersion;
 };
 
+inline uint qHash(const FrameKey &key, uint seed = 0)
+{
+    return qHash(key.settings.minX, seed) ^ qHash(key.settings.maxX, seed) * 3
+            ^ qHash(key.settings.minY, seed) * 5 ^ qHash(key.settings.maxY, seed) * 7
+            ^ qHash(key.size.width() * 65536 + key.size.height(), seed) ^ uint(key.dataVersion) * 11;
+}
+
 class GraphView: public QWidget
 {
     Q_OBJECT
 
 public:
     GraphView(QWidget * parent = 0);
+    ~GraphView();
 
     void setModel(TableModel *model);
 
     void setPlotSettings(const PlotSettings &settings);
 
-    void setCurve(const QVector<QPointF> &data);
-    void clearCurve();
-
     QSize minimumSizeHint() const;
     QSize sizeHint() const;
 
+    // true when the frame on screen shows the current view and data
+    bool isFrameCurrent() const { return !refreshScheduled && frameId == pendingFrame; };
+
+signals:
+    void frameRequested(int id, const RenderJob &job);
+    // the cursor readout moved to another row of the model
+    void rowHovered(int row);
+
 public slots:
     void updateChangedData(QModelIndex topLeft ,QModelIndex bottomRight);
+    void updateInsertedData(const QModelIndex &parent, int first, int last);
+    void updateRemovedData(const QModelIndex &parent, int first, int last);
+    void updateMovedData(const QModelIndex &parent, int first, int last,
+                         const QModelIndex &destination, int row);
     void updateAllData();
+    void resetAllData();
+    void updateLabels();
 
     void zoomIn();
     void zoomOut();
 
+    // overlay of the recent frame times and the points drawn
+    void setFrameTimingVisible(bool visible);
+    // counts on a log10 axis, starts again from the full view
+    void setLogScale(bool on);
+    // crosshair on the sample nearest to the mouse, with its energy and counts
+    void setCursorReadout(bool on);
+
 protected:
     void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *event);
     void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
+    void leaveEvent(QEvent *event);
     void keyPressEvent(QKeyEvent *event);
     void wheelEvent(QWheelEvent *event);
 
+private slots:
+    void scheduledRefresh();
+    void frameRendered(int id, const QImage &image, const PlotSettings &settings,
+                       int points, qint64 nsecs);
+
 private:
     void updateRubberBandRegion();
     void refreshPixmap();
-    void drawGrid(QPainter *painter);
-    void drawCurves(QPainter *painter);
-    void upDatePlotSettings();
-
-    enum { Margin = 50 };
-
-    QVector<double> dataX,dataY;
-    QString labelX,labelY;
+    bool upDatePlotSettings(bool resetZoom = false);
+    bool rowsVisible(int first, int last) const;
+    void scheduleRefresh();
+    void invalidateFrames();
+    void drawFrame(QPainter *painter);
+    void drawFrameTiming(QPainter *painter);
+    // the cursor row still exists, the data may have changed under it
+    bool hasCursor() const { return cursorRow >= 0 && cursorRow < model->rowCount(); };
+    void updateCursor(const QPoint &pos);
+    void drawCursor(QPainter *painter);
+    QString cursorText() const;
+    QRect cursorLabelRect() const;
+    QRegion cursorRegion() const;
+    int cursorX() const;
+
+    enum { Margin = PlotRenderer::Margin };
+    enum { FrameCacheSize = 64 * 1024 };    // in KB
+
+    // frames are drawn from snapshots of the model on the render thread
     TableModel *model;
+    int dataVersion;                // counts the changes of the model
+    RenderWorker *worker;
+    QThread renderThread;
 
     QToolButton *zoomInButton;
     QToolButton *zoomOutButton;
 
+    PlotSettings dataExtents;       // raw data bounds behind zoomStack[0]
     QVector<PlotSettings> zoomStack;
     int curZoom;
     bool rubberBandIsShown;
+    bool refreshScheduled;
     QRect rubberBandRect;
-    QPixmap pixmap;
+
+    QImage frame;                   // last completed frame
+    PlotSettings frameSettings;     // the view it shows
+    int frameId;
+    int pendingFrame;               // id of the latest request
+    int pendingVersion;             // and the data version it shows
+    // recently shown frames, least recently used dropped first; stepping
+    // through the zoom history takes a blit instead of a render
+    QCache<FrameKey, QImage> frameCache;
+
+    bool logScale;
+    bool frameTimingVisible;
+    QVector<qint64> frameTimes;     // ring of the last frames, in ns
+    int frameCount;
+    int pointsDrawn;                // curve vertices of the last frame
+
+    bool cursorReadout;
+    QPoint cursorPos;
+    int cursorRow;                  // nearest row to the mouse, -1 for none
 };
 
 #endif // GRAPHVIEW_H
@@ -1,11 +1,39 @@
 #include "mainwindow.h"
+#include "batchprocessor.h"
+#include "tracer.h"
 #include <QApplication>
+#include <cstdio>
 
-int main(int argc, char *argv[])
+static int run(int argc, char *argv[])
 {
+    // headless batch mode, see batchprocessor.h
+    if (argc > 1 && BatchProcessor::isCommand(QString::fromLocal8Bit(argv[1])))
+    {
+        // images are rendered without a display
+        if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        QApplication a(argc, argv);
+        BatchProcessor batch;
+        return batch.run(a.arguments());
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
 
     return a.exec();
 }
+
+int main(int argc, char *argv[])
+{
+    // DATAVIEWER_TRACE=file.json records a trace of the whole run
+    const QString traceFile = QString::fromLocal8Bit(qgetenv("DATAVIEWER_TRACE"));
+    Tracer::setEnabled(!traceFile.isEmpty());
+
+    int result = run(argc, argv);
+
+    QString errorString;
+    if (!traceFile.isEmpty() && !Tracer::writeChromeTrace(traceFile, errorString))
+        std::fprintf(stderr, "%s: %s\n", qPrintable(traceFile), qPrintable(errorString));
+    return result;
+}
@@ -1,16 +1,52 @@
+#include <algorithm>
+
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "spectrumfile.h"
+#include "tracer.h"
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
+    loadingModel(NULL), loadId(0), loadedBytes(0), syncingScroll(false), hoveredRow(-1),
     ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
 
     model = new TableModel;
-    ui->tableView->setModel(model);
+    displayModel = new TableDisplayModel(this);
+    displayModel->setSourceModel(model);
+    ui->tableView->setModel(displayModel);
+    // rows of one height, so the header needs no per-row sizes
+    ui->tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    editTriggers = ui->tableView->editTriggers();
+    connect(ui->tableView->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(tableScrolled()));
+    connect(ui->tableView->verticalScrollBar(), SIGNAL(rangeChanged(int,int)), this, SLOT(updateRowScrollBar()));
+    connect(displayModel, SIGNAL(windowChanged()), this, SLOT(updateRowScrollBar()));
+    connect(ui->rowScrollBar, SIGNAL(valueChanged(int)), this, SLOT(scrollTableTo(int)));
+    // the window only follows the cursor once it rests
+    hoverTimer.setSingleShot(true);
+    hoverTimer.setInterval(150);
+    connect(&hoverTimer, SIGNAL(timeout()), this, SLOT(showHoveredRow()));
     ui->graphView->setModel(model);
 
+    loader = new FileLoader;
+    loader->moveToThread(&loaderThread);
+    connect(loader, SIGNAL(started(int,QStringList,int)), this, SLOT(loadStarted(int,QStringList,int)));
+    connect(loader, SIGNAL(rowsReady(int,ColumnBlock)), this, SLOT(loadRowsReady(int,ColumnBlock)));
+    connect(loader, SIGNAL(progress(int,int)), this, SLOT(loadProgress(int,int)));
+    connect(loader, SIGNAL(finished(int,qint64)), this, SLOT(loadFinished(int,qint64)));
+    connect(loader, SIGNAL(failed(int,QString)), this, SLOT(loadFailed(int,QString)));
+    loaderThread.start();
+
+    progressBar = new QProgressBar;
+    progressBar->setMaximumWidth(150);
+    progressBar->hide();
+    statusBar()->addPermanentWidget(progressBar);
+
+    tailer = new FileTailer(this);
+    connect(tailer, SIGNAL(rowsAppended(ColumnBlock)), this, SLOT(tailRowsAppended(ColumnBlock)));
+    connect(tailer, SIGNAL(failed(QString)), this, SLOT(tailFailed(QString)));
+
     createActions();
     createMenus();
     readSettings();
@@ -23,6 +59,13 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    loader->cancel();
+    loaderThread.quit();
+    loaderThread.wait();
+    delete loader;
+    if(loadingModel!=NULL)
+        delete loadingModel;
+
     if(ui!=NULL)
         delete ui;
     if(contextMenu!=NULL)
@@ -31,19 +74,50 @@ MainWindow::~MainWindow()
         delete model;
 }
 
+// rows of the model in the table selection in order, or the current row
+QVector<int> MainWindow::selectedRows() const
+{
+    QVector<int> rows;
+    const QItemSelection selection = ui->tableView->selectionModel()->selection();
+    for (int i = 0; i < selection.size(); ++i)
+    {
+        for (int row = selection.at(i).top(); row <= selection.at(i).bottom(); ++row)
+            rows.append(displayModel->mapToSource(row));
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.isEmpty() && ui->tableView->currentIndex().isValid())
+        rows.append(displayModel->mapToSource(ui->tableView->currentIndex().row()));
+    return rows;
+}
+
+// as many new rows as are selected, before the first of them
 void MainWindow::insert()
 {
-    model->insert(index);
+    const QVector<int> rows = selectedRows();
+    if (!rows.isEmpty() && !model->insertRows(rows.first(), rows.size(), QModelIndex()))
+        statusBar()->showMessage(tr("No room for %1 rows between these energies").arg(rows.size()), 2000);
 }
 
 void MainWindow::remove()
 {
-    if (index.isValid())
+    const QVector<int> rows = selectedRows();
+    if (!rows.isEmpty())
     {
-        model->remove(index);
+        model->removeRowSet(rows);
+        ui->tableView->clearSelection();
     }
 }
 
+void MainWindow::paste()
+{
+    const int rows = model->rowCount();
+    if (model->pasteRows(QApplication::clipboard()->text()))
+        statusBar()->showMessage(tr("Pasted, %1 new rows").arg(model->rowCount() - rows), 2000);
+    else
+        statusBar()->showMessage(tr("Cannot paste: %1").arg(model->errorString()), 5000);
+}
+
 void MainWindow::closeEvent(QCloseEvent *event)
 {
     if (maybeSave())
@@ -59,8 +133,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 
 void MainWindow::onCustomContextMenu(const QPoint &point)
 {
-    index = ui->tableView->indexAt(point);
-    if (index.isValid())
+    if (ui->tableView->indexAt(point).isValid())
     {
         contextMenu->exec(ui->tableView->mapToGlobal(point));
     }
@@ -70,12 +143,16 @@ void MainWindow::newFile()
 {
     if (maybeSave())
     {
+        discardLoad();
+        followAct->setChecked(false);
+        followAct->setEnabled(false);
         setCurrentFile("");
         if (model!=NULL)
         {
-            delete model;
+            TableModel *oldModel = model;
             model= new TableModel;
-            ui->tableView->setModel(model);
+            setViewModel(model);
+            delete oldModel;
         }
     }
 }
@@ -87,7 +164,8 @@ void MainWindow::open()
         QString fileName = QFileDialog::getOpenFileName(this,
                                                         tr("Open File"),
                                                         "",
-                                                        tr("Tables (*.csv)"));
+                                                        tr("Tables and spectra (*.csv *.dvs);;"
+                                                           "Tables (*.csv);;Spectra (*.dvs)"));
         if (!fileName.isEmpty())
             loadFile(fileName);
     }
@@ -106,13 +184,19 @@ bool MainWindow::save()
 
 bool MainWindow::saveAs()
 {
+    QString spectraFilter = tr("Spectra (*.dvs)");
+    QString selectedFilter;
     QString file = QFileDialog::getSaveFileName(this,
                                                tr("Save as"),
                                                tr(""),
-                                               tr("Tables (*.csv)"));
+                                               tr("Tables (*.csv)") + ";;" + spectraFilter,
+                                               &selectedFilter);
     if (file.isEmpty())
         return false;
 
+    if (QFileInfo(file).suffix().isEmpty())
+        file += (selectedFilter == spectraFilter) ? ".dvs" : ".csv";
+
     return saveFile(file);
 }
 
@@ -130,14 +214,69 @@ void MainWindow::createActions()
     saveAsAct = new QAction(tr("Save &As..."), this);
     connect(saveAsAct, SIGNAL(triggered()), this, SLOT(saveAs()));
 
+    cancelLoadAct = new QAction(tr("&Cancel Loading"), this);
+    cancelLoadAct->setShortcut(QKeySequence(Qt::Key_Escape));
+    cancelLoadAct->setEnabled(false);
+    connect(cancelLoadAct, SIGNAL(triggered()), this, SLOT(cancelLoad()));
+
+    followAct = new QAction(tr("&Follow File"), this);
+    followAct->setCheckable(true);
+    followAct->setEnabled(false);
+    followAct->setToolTip(tr("Add rows appended to the file while it is being written"));
+    connect(followAct, SIGNAL(toggled(bool)), this, SLOT(followFile(bool)));
+
     exitAct = new QAction(tr("&Exit"), this);
     connect(exitAct, SIGNAL(triggered()), this, SLOT(close()));
 
+    logScaleAct = new QAction(tr("&Logarithmic Counts"), this);
+    logScaleAct->setCheckable(true);
+    logScaleAct->setShortcut(tr("Ctrl+L"));
+    logScaleAct->setToolTip(tr("Show the counts on a logarithmic axis"));
+    connect(logScaleAct, SIGNAL(toggled(bool)), ui->graphView, SLOT(setLogScale(bool)));
+
+    cursorReadoutAct = new QAction(tr("Cursor &Readout"), this);
+    cursorReadoutAct->setCheckable(true);
+    cursorReadoutAct->setShortcut(tr("Ctrl+R"));
+    cursorReadoutAct->setToolTip(tr("Show the energy and counts under the mouse and their row in the table"));
+    connect(cursorReadoutAct, SIGNAL(toggled(bool)), ui->graphView, SLOT(setCursorReadout(bool)));
+    connect(ui->graphView, SIGNAL(rowHovered(int)), this, SLOT(showRow(int)));
+
+    compactCountsAct = new QAction(tr("&Compact Counts"), this);
+    compactCountsAct->setCheckable(true);
+    compactCountsAct->setToolTip(tr("Keep the count columns packed in memory, for very large tables"));
+    connect(compactCountsAct, SIGNAL(toggled(bool)), this, SLOT(compactCounts(bool)));
+
+    frameTimingAct = new QAction(tr("&Frame Timing"), this);
+    frameTimingAct->setCheckable(true);
+    frameTimingAct->setToolTip(tr("Show the time and the points of the recent graph frames"));
+    connect(frameTimingAct, SIGNAL(toggled(bool)), ui->graphView, SLOT(setFrameTimingVisible(bool)));
+
+    traceAct = new QAction(tr("&Record Trace"), this);
+    traceAct->setCheckable(true);
+    traceAct->setChecked(Tracer::isEnabled());
+    traceAct->setToolTip(tr("Record the time spent in loading, sorting, model updates and drawing"));
+    connect(traceAct, SIGNAL(toggled(bool)), this, SLOT(recordTrace(bool)));
+
+    exportTraceAct = new QAction(tr("&Export Trace..."), this);
+    connect(exportTraceAct, SIGNAL(triggered()), this, SLOT(exportTrace()));
+
     insertAct= new QAction(tr("&Insert"), this);
     connect(insertAct, SIGNAL(triggered()), this, SLOT(insert()));
 
     removeAct= new QAction(tr("&Remove"), this);
+    removeAct->setShortcut(QKeySequence::Delete);
+    removeAct->setShortcutContext(Qt::WidgetShortcut);
     connect(removeAct, SIGNAL(triggered()), this, SLOT(remove()));
+
+    pasteAct= new QAction(tr("&Paste"), this);
+    pasteAct->setShortcut(QKeySequence::Paste);
+    pasteAct->setShortcutContext(Qt::WidgetShortcut);
+    pasteAct->setToolTip(tr("Add csv or tab separated rows from the clipboard, existing energies get the new counts"));
+    connect(pasteAct, SIGNAL(triggered()), this, SLOT(paste()));
+
+    // the shortcuts work while the table has the focus
+    ui->tableView->addAction(removeAct);
+    ui->tableView->addAction(pasteAct);
 }
 
 void MainWindow::createMenus()
@@ -146,6 +285,8 @@ void MainWindow::createMenus()
     fileMenu->addAction(newAct);
 
     fileMenu->addAction(openAct);
+    fileMenu->addAction(cancelLoadAct);
+    fileMenu->addAction(followAct);
 
     fileMenu->addAction(saveAct);
 
@@ -153,9 +294,25 @@ void MainWindow::createMenus()
     fileMenu->addSeparator();
     fileMenu->addAction(exitAct);
 
+    viewMenu = menuBar()->addMenu(tr("&View"));
+    viewMenu->addAction(logScaleAct);
+    viewMenu->addAction(cursorReadoutAct);
+    viewMenu->addSeparator();
+    viewMenu->addAction(compactCountsAct);
+    viewMenu->addSeparator();
+    viewMenu->addAction(frameTimingAct);
+    viewMenu->addSeparator();
+    viewMenu->addAction(traceAct);
+    viewMenu->addAction(exportTraceAct);
+
+    ui->mainToolBar->addAction(cancelLoadAct);
+    ui->mainToolBar->addAction(followAct);
+
     contextMenu=new QMenu();
     contextMenu->addAction(insertAct);
     contextMenu->addAction(removeAct);
+    contextMenu->addSeparator();
+    contextMenu->addAction(pasteAct);
 }
 
 void MainWindow::readSettings()
@@ -192,39 +349,184 @@ bool MainWindow::maybeSave()
     return true;
 }
 
+// start parsing on the loader thread, rows show up as they are parsed
 void MainWindow::loadFile(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly | QFile::Text))
-    {
-        QMessageBox::warning(this, tr("Application"),
-                             tr("Cannot read file %1:\n%2.")
-                             .arg(fileName)
-                             .arg(file.errorString()));
+    discardLoad();
+    followAct->setChecked(false);
+
+    loadId = loader->requestLoad();
+    loadingFile = fileName;
+    loadTimer.start();
+    QMetaObject::invokeMethod(loader, "load", Qt::QueuedConnection,
+                              Q_ARG(int, loadId), Q_ARG(QString, fileName));
+
+    progressBar->setValue(0);
+    progressBar->show();
+    cancelLoadAct->setEnabled(true);
+    statusBar()->showMessage(tr("Loading %1...").arg(fileName));
+}
+
+void MainWindow::loadStarted(int id, const QStringList &header, int estimatedRows)
+{
+    if (id != loadId)
         return;
+
+    loadingModel = new TableModel;
+    loadingModel->beginLoading(header, estimatedRows);
+    setViewModel(loadingModel);
+    setLoading(true);
+}
+
+void MainWindow::loadRowsReady(int id, const ColumnBlock &rows)
+{
+    if (id != loadId || loadingModel == NULL)
+        return;
+
+    loadingModel->appendRows(rows);
+}
+
+void MainWindow::loadProgress(int id, int percent)
+{
+    if (id == loadId)
+        progressBar->setValue(percent);
+}
+
+void MainWindow::loadFinished(int id, qint64 bytesRead)
+{
+    if (id != loadId || loadingModel == NULL)
+        return;
+
+    loadedBytes = bytesRead;
+    loadingModel->endLoading();
+
+    // the loaded model replaces the previous one
+    TableModel *oldModel = model;
+    model = loadingModel;
+    loadingModel = NULL;
+    delete oldModel;
+    discardLoad();
+    setLoading(false);
+    setCurrentFile(loadingFile);
+    followAct->setEnabled(bytesRead > 0);   // csv files only
+
+    // report ingest throughput
+    double seconds = qMax<qint64>(loadTimer.elapsed(), 1) / 1000.0;
+    double megaBytes = QFileInfo(loadingFile).size() / (1024.0 * 1024.0);
+    QString message = tr("Loaded %1 rows in %2 s (%3 MB/s)")
+            .arg(model->rowCount())
+            .arg(seconds, 0, 'f', 2)
+            .arg(megaBytes / seconds, 0, 'f', 1);
+    if (model->duplicateCount() > 0)
+        message += tr(", %1 duplicate energies").arg(model->duplicateCount());
+    statusBar()->showMessage(message);
+}
+
+void MainWindow::loadFailed(int id, const QString &message)
+{
+    if (id != loadId)
+        return;
+
+    discardLoad();
+    statusBar()->clearMessage();
+    QMessageBox::warning(this, tr("Application"),
+                         tr("Cannot read file %1:\n%2.")
+                         .arg(loadingFile)
+                         .arg(message));
+}
+
+void MainWindow::cancelLoad()
+{
+    if (loadId == 0)
+        return;
+
+    discardLoad();
+    statusBar()->showMessage(tr("Loading cancelled"), 3000);
+}
+
+// stop a running load and go back to the current model
+void MainWindow::discardLoad()
+{
+    loader->cancel();
+    loadId = 0;
+    if (loadingModel != NULL)
+    {
+        setViewModel(model);
+        delete loadingModel;
+        loadingModel = NULL;
+        setLoading(false);
     }
+    progressBar->hide();
+    cancelLoadAct->setEnabled(false);
+}
 
-    QTextStream in(&file);
-    model->loadFile(in);
-    ui->tableView->setModel(model);
-    setCurrentFile(fileName);
+// A model that is being loaded is shown read-only: the row actions would
+// act on the hidden current model, and edits would be lost when the load
+// ends. Following needs the loaded file, so it waits as well.
+void MainWindow::setLoading(bool loading)
+{
+    ui->tableView->setEditTriggers(loading ? QAbstractItemView::NoEditTriggers : editTriggers);
+    insertAct->setEnabled(!loading);
+    removeAct->setEnabled(!loading);
+    pasteAct->setEnabled(!loading);
+    if (loading)
+        followAct->setChecked(false);
+    // only csv files can be followed
+    followAct->setEnabled(!loading && !curFile.isEmpty()
+                          && QFileInfo(curFile).suffix().compare(SpectrumFile::suffix(), Qt::CaseInsensitive) != 0);
+}
+
+void MainWindow::followFile(bool follow)
+{
+    if (follow && !curFile.isEmpty())
+    {
+        tailer->start(curFile, loadedBytes, model->columnCount());
+        statusBar()->showMessage(tr("Following %1").arg(curFile), 3000);
+    }
+    else
+    {
+        tailer->stop();
+    }
+}
+
+void MainWindow::tailRowsAppended(const ColumnBlock &rows)
+{
+    model->mergeRows(rows);
+    statusBar()->showMessage(tr("%1 new rows, %2 in total")
+                             .arg(rows.size()).arg(model->rowCount()), 3000);
+}
+
+void MainWindow::tailFailed(const QString &message)
+{
+    followAct->setChecked(false);
+    statusBar()->showMessage(tr("Stopped following: %1").arg(message));
+}
+
+void MainWindow::setViewModel(TableModel *viewModel)
+{
+    viewModel->setCompactCounts(compactCountsAct->isChecked());
+    displayModel->setSourceModel(viewModel);
+    ui->graphView->setModel(viewModel);
 }
 
 bool MainWindow::saveFile(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::WriteOnly | QFile::Text))
+    // the saved file replaces what was being followed
+    followAct->setChecked(false);
+
+    if (!model->saveFile(fileName))
     {
         QMessageBox::warning(this, tr("Application"),
                              tr("Cannot write file %1:\n%2.")
                              .arg(fileName)
-                             .arg(file.errorString()));
+                             .arg(model->errorString()));
         return false;
     }
 
-    QTextStream out(&file);
-    model->saveFile(out);
-
+    // only csv files can be followed
+    bool isCsv = QFileInfo(fileName).suffix().compare(SpectrumFile::suffix(), Qt::CaseInsensitive) != 0;
+    loadedBytes = QFileInfo(fileName).size();
+    followAct->setEnabled(isCsv);
     setCurrentFile(fileName);
     return true;
 }
@@ -240,3 +542,116 @@ void MainWindow::setCurrentFile(const QString &fileName)
     setWindowFilePath(shownName);
 }
 
+// The row under the graph cursor becomes the current row of the table,
+// leaving the selection alone. A row in the display window is shown at
+// once; for one outside it the window is only moved when the cursor rests,
+// not for every row it passes on the way.
+void MainWindow::showRow(int row)
+{
+    hoveredRow = row;
+    const int windowRow = displayModel->mapFromSource(row);
+    if (windowRow < 0)
+    {
+        hoverTimer.start();
+        return;
+    }
+    hoverTimer.stop();
+    const QModelIndex rowIndex = displayModel->index(windowRow, 0);
+    ui->tableView->selectionModel()->setCurrentIndex(rowIndex, QItemSelectionModel::NoUpdate);
+    ui->tableView->scrollTo(rowIndex);
+}
+
+void MainWindow::showHoveredRow()
+{
+    const int rows = displayModel->sourceModel() != NULL ? displayModel->sourceModel()->rowCount() : 0;
+    if (hoveredRow < 0 || hoveredRow >= rows)
+        return;
+    scrollTableTo(hoveredRow);
+    showRow(hoveredRow);
+}
+
+// The table view scrolls through the display window, the row scroll bar
+// beside it through the whole table. The window is moved when the view
+// comes within a page of one of its ends, or when the bar leaves it.
+void MainWindow::tableScrolled()
+{
+    if (syncingScroll)
+        return;
+    const QScrollBar *bar = ui->tableView->verticalScrollBar();
+    const int first = displayModel->firstRow();
+    const int rows = displayModel->sourceModel() != NULL ? displayModel->sourceModel()->rowCount() : 0;
+    if ((first > 0 && bar->value() < bar->pageStep())
+            || (first + displayModel->rowCount() < rows && bar->value() > bar->maximum() - bar->pageStep()))
+        scrollTableTo(first + bar->value(), true);
+    else
+        updateRowScrollBar();
+}
+
+// row at the top of the table view, with the window centred on it if it
+// is not in the window or recenter is set
+void MainWindow::scrollTableTo(int row, bool recenter)
+{
+    if (syncingScroll)
+        return;
+    QScrollBar *bar = ui->tableView->verticalScrollBar();
+    syncingScroll = true;
+    const int first = displayModel->firstRow();
+    if (recenter || row < first || row > first + bar->maximum())
+        displayModel->setFirstRow(row - TableDisplayModel::WindowRows / 2);
+    bar->setValue(row - displayModel->firstRow());
+    syncingScroll = false;
+    updateRowScrollBar();
+}
+
+void MainWindow::updateRowScrollBar()
+{
+    if (syncingScroll)
+        return;
+    const QScrollBar *bar = ui->tableView->verticalScrollBar();
+    const int rows = displayModel->sourceModel() != NULL ? displayModel->sourceModel()->rowCount() : 0;
+    syncingScroll = true;
+    ui->rowScrollBar->setRange(0, qMax(0, rows - displayModel->rowCount() + bar->maximum()));
+    ui->rowScrollBar->setPageStep(bar->pageStep());
+    ui->rowScrollBar->setValue(displayModel->firstRow() + bar->value());
+    syncingScroll = false;
+}
+
+// applies to the shown model and to every later one, see setViewModel()
+void MainWindow::compactCounts(bool compact)
+{
+    model->setCompactCounts(compact);
+    if (loadingModel != NULL)
+        loadingModel->setCompactCounts(compact);
+    const TableModel *shown = loadingModel != NULL ? loadingModel : model;
+    statusBar()->showMessage(tr("Counts take %1 MB")
+                             .arg(shown->countsMemorySize() / (1024.0 * 1024.0), 0, 'f', 1), 3000);
+}
+
+// start a new recording, or stop and keep what was recorded for export
+void MainWindow::recordTrace(bool record)
+{
+    if (record)
+        Tracer::clear();
+    Tracer::setEnabled(record);
+}
+
+void MainWindow::exportTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export Trace"), QString(),
+                                                    tr("Chrome trace (*.json)"));
+    if (fileName.isEmpty())
+        return;
+    if (!fileName.endsWith(".json", Qt::CaseInsensitive))
+        fileName += ".json";
+
+    QString errorString;
+    if (!Tracer::writeChromeTrace(fileName, errorString))
+    {
+        QMessageBox::warning(this, tr("Application"),
+                             tr("Cannot write file %1:\n%2.")
+                             .arg(fileName)
+                             .arg(errorString));
+        return;
+    }
+    statusBar()->showMessage(tr("%1 events written to %2").arg(Tracer::eventCount()).arg(fileName), 3000);
+}
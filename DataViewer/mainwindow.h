@@ -8,9 +8,15 @@
 #include <QModelIndex>
 #include <QTableView>
 #include <QtWidgets>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include "tablemodel.h"
+#include "tabledisplaymodel.h"
 #include "graphview.h"
+#include "fileloader.h"
+#include "filetailer.h"
 
 namespace Ui {
 class MainWindow;
@@ -33,10 +39,32 @@ private slots:
     bool save();
     bool saveAs();
 
+private slots:
+    void loadStarted(int id, const QStringList &header, int estimatedRows);
+    void loadRowsReady(int id, const ColumnBlock &rows);
+    void loadProgress(int id, int percent);
+    void loadFinished(int id, qint64 bytesRead);
+    void loadFailed(int id, const QString &message);
+    void cancelLoad();
+
+    void followFile(bool follow);
+    void tailRowsAppended(const ColumnBlock &rows);
+    void tailFailed(const QString &message);
+
+    void compactCounts(bool compact);
+    void showRow(int row);
+    void showHoveredRow();
+    void tableScrolled();
+    void scrollTableTo(int row, bool recenter = false);
+    void updateRowScrollBar();
+    void recordTrace(bool record);
+    void exportTrace();
+
 private slots:
      void onCustomContextMenu(const QPoint &);
      void insert();
      void remove();
+     void paste();
 
 private:
     void createActions();
@@ -47,10 +75,15 @@ private:
     void loadFile(const QString &fileName);
     bool saveFile(const QString &fileName);
     void setCurrentFile(const QString &fileName);
+    void setViewModel(TableModel *viewModel);
+    void discardLoad();
+    void setLoading(bool loading);
+    QVector<int> selectedRows() const;
 
     QString curFile;
 
     QMenu *fileMenu;            // File operation menu (new/open/save/save as/exit)
+    QMenu *viewMenu;            // graph timing and tracing
     QMenu *contextMenu;         // Right click menu for table actions (insert Column/remove Column)
 
     // File operation actions
@@ -58,16 +91,46 @@ private:
     QAction *openAct;
     QAction *saveAct;
     QAction *saveAsAct;
+    QAction *cancelLoadAct;
+    QAction *followAct;
     QAction *exitAct;
 
+    // View actions
+    QAction *logScaleAct;
+    QAction *compactCountsAct;
+    QAction *cursorReadoutAct;
+    QAction *frameTimingAct;
+    QAction *traceAct;
+    QAction *exportTraceAct;
+
     // Table operation actions
     QAction *insertAct;
     QAction *removeAct;
+    QAction *pasteAct;
 
     TableModel *model;
+    TableDisplayModel *displayModel;    // what the table view shows of model
+    QAbstractItemView::EditTriggers editTriggers;   // of the table, when it is not loading
+
+    // background loading, the new model is only swapped in when complete
+    QThread loaderThread;
+    FileLoader *loader;
+    TableModel *loadingModel;
+    QString loadingFile;
+    int loadId;
+    QElapsedTimer loadTimer;
+    QProgressBar *progressBar;
+
+    // follow mode for a csv file that is still growing
+    FileTailer *tailer;
+    qint64 loadedBytes;     // of curFile, where following starts
+
+    bool syncingScroll;     // while the table view and the row scroll bar are lined up
+    int hoveredRow;         // last row under the graph cursor
+    QTimer hoverTimer;      // moves the display window to hoveredRow
+
     QTableView *tableView;
     GraphView *graphView;
-    QModelIndex index;
     Ui::MainWindow *ui;
 };
 
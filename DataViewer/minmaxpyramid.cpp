@@ -0,0 +1,153 @@
+#include "minmaxpyramid.h"
+#include "compressedcounts.h"
+
+MinMaxPyramid::MinMaxPyramid() :
+    mSize(0)
+{
+}
+
+void MinMaxPyramid::clear()
+{
+    levels.clear();
+    mSize = 0;
+}
+
+void MinMaxPyramid::build(const unsigned int *values, int size)
+{
+    levels.clear();
+    mSize = 0;
+    if (size > 0)
+        update(values, size, 0, size - 1);
+}
+
+template <typename Values>
+void MinMaxPyramid::updateValues(const Values &values, int size, int first, int last)
+{
+    if (size <= 0)
+    {
+        clear();
+        return;
+    }
+    first = qMax(first, 0);
+    last = qMin(last, size - 1);
+    if (size != mSize)
+        last = size - 1;    // blocks at the end appear or disappear
+    mSize = size;
+
+    // one level per factor of 16, until a single block is left
+    int levelCount = 0;
+    for (int n = size; n > 1; n = (n + BlockSize - 1) >> BlockShift)
+        ++levelCount;
+    levels.resize(levelCount);
+
+    int count = size;
+    for (int level = 0; level < levelCount; ++level)
+    {
+        const int blocks = (count + BlockSize - 1) >> BlockShift;
+        QVector<Extent> &extents = levels[level];
+        extents.resize(blocks);
+        Extent *out = extents.data();
+
+        const int firstBlock = first >> BlockShift;
+        const int lastBlock = last >> BlockShift;
+        for (int block = firstBlock; block <= lastBlock; ++block)
+        {
+            const int begin = block << BlockShift;
+            const int end = qMin(begin + BlockSize, count);
+            Extent extent;
+            if (level == 0)
+            {
+                extent.min = extent.max = values[begin];
+                for (int i = begin + 1; i < end; ++i)
+                {
+                    extent.min = qMin(extent.min, values[i]);
+                    extent.max = qMax(extent.max, values[i]);
+                }
+            }
+            else
+            {
+                const Extent *in = levels.at(level - 1).constData();
+                extent = in[begin];
+                for (int i = begin + 1; i < end; ++i)
+                {
+                    extent.min = qMin(extent.min, in[i].min);
+                    extent.max = qMax(extent.max, in[i].max);
+                }
+            }
+            out[block] = extent;
+        }
+
+        first = firstBlock;
+        last = lastBlock;
+        count = blocks;
+    }
+}
+
+template <typename Values>
+void MinMaxPyramid::queryValues(const Values &values, int first, int last,
+                                unsigned int &min, unsigned int &max) const
+{
+    min = max = values[first];
+
+    // raw values up to the first block boundaries
+    int level = 0;
+    const int levelCount = levels.size();
+    while (first < last && (first & (BlockSize - 1)) != 0)
+    {
+        min = qMin(min, values[first]);
+        max = qMax(max, values[first]);
+        ++first;
+    }
+    while (first < last && (last & (BlockSize - 1)) != 0)
+    {
+        --last;
+        min = qMin(min, values[last]);
+        max = qMax(max, values[last]);
+    }
+    first >>= BlockShift;
+    last >>= BlockShift;
+
+    // then whole blocks, going up a level whenever possible
+    while (first < last)
+    {
+        const Extent *extents = levels.at(level).constData();
+        const bool top = (level + 1 == levelCount);
+        while (first < last && (top || (first & (BlockSize - 1)) != 0))
+        {
+            min = qMin(min, extents[first].min);
+            max = qMax(max, extents[first].max);
+            ++first;
+        }
+        while (first < last && (last & (BlockSize - 1)) != 0)
+        {
+            --last;
+            min = qMin(min, extents[last].min);
+            max = qMax(max, extents[last].max);
+        }
+        first >>= BlockShift;
+        last >>= BlockShift;
+        ++level;
+    }
+}
+
+void MinMaxPyramid::update(const unsigned int *values, int size, int first, int last)
+{
+    updateValues(values, size, first, last);
+}
+
+void MinMaxPyramid::update(const CompressedCounts &values, int first, int last)
+{
+    updateValues(values, values.size(), first, last);
+}
+
+void MinMaxPyramid::query(const unsigned int *values, int first, int last,
+                          unsigned int &min, unsigned int &max) const
+{
+    queryValues(values, first, last, min, max);
+}
+
+void MinMaxPyramid::query(const CompressedCounts &values, int first, int last,
+                          unsigned int &min, unsigned int &max) const
+{
+    queryValues(values, first, last, min, max);
+}
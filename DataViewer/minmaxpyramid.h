@@ -0,0 +1,49 @@
+#ifndef MINMAXPYRAMID_H
+#define MINMAXPYRAMID_H
+
+#include <QVector>
+
+class CompressedCounts;
+
+// Hierarchical min/max index over a column of counts.
+// Level k holds the min and max of blocks of 16^k values, the values
+// themselves are level 0 and are not copied. The min/max of any row
+// range is answered by touching at most 2*16 entries per level.
+class MinMaxPyramid
+{
+public:
+    MinMaxPyramid();
+
+    void clear();
+    void build(const unsigned int *values, int size);
+    // recompute the blocks covering rows [first, last], after the values
+    // changed there; size may differ from the previous call
+    void update(const unsigned int *values, int size, int first, int last);
+    void update(const CompressedCounts &values, int first, int last);
+
+    // min and max of values[first, last), the range must not be empty
+    void query(const unsigned int *values, int first, int last,
+               unsigned int &min, unsigned int &max) const;
+    void query(const CompressedCounts &values, int first, int last,
+               unsigned int &min, unsigned int &max) const;
+
+private:
+    enum { BlockShift = 4, BlockSize = 1 << BlockShift };
+
+    struct Extent
+    {
+        unsigned int min, max;
+    };
+
+    // the same for plain and packed columns, which only differ in values[i]
+    template <typename Values>
+    void updateValues(const Values &values, int size, int first, int last);
+    template <typename Values>
+    void queryValues(const Values &values, int first, int last,
+                     unsigned int &min, unsigned int &max) const;
+
+    QVector< QVector<Extent> > levels;   // levels[0] is the first aggregated level
+    int mSize;
+};
+
+#endif // MINMAXPYRAMID_H
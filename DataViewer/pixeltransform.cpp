@@ -0,0 +1,292 @@
+#include <QAtomicInt>
+
+#include "pixeltransform.h"
+#include "simd.h"
+
+// counts are converted a chunk at a time into doubles that stay in cache
+static const int chunkSize = 512;
+
+// The kernels below compute px = offsetX + x * scaleX and
+// py = offsetY - y * scaleY, clamped to [low, high], and store them as
+// interleaved x, y pairs, which is the layout of an array of QPointF.
+
+static void convertCountsScalar(const unsigned int *counts, int n, double *out)
+{
+    for (int i = 0; i < n; ++i)
+        out[i] = counts[i];
+}
+
+static void mapPointsScalar(const double *x, const double *y, int n, double *out,
+                            double offsetX, double scaleX, double offsetY, double scaleY,
+                            double low, double high)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        out[2 * i] = qBound(low, offsetX + x[i] * scaleX, high);
+        out[2 * i + 1] = qBound(low, offsetY - y[i] * scaleY, high);
+    }
+}
+
+static void mapXScalar(const double *x, int n, double *out, double offsetX, double scaleX)
+{
+    for (int i = 0; i < n; ++i)
+        out[i] = offsetX + x[i] * scaleX;
+}
+
+#ifdef DATAVIEWER_HAVE_SSE2
+// unsigned to double: flip the sign bit, convert as signed, add 2^31 back
+static void convertCountsSse2(const unsigned int *counts, int n, double *out)
+{
+    const __m128i bias = _mm_set1_epi32(int(0x80000000u));
+    const __m128d offset = _mm_set1_pd(2147483648.0);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(counts + i));
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_cvtepi32_pd(_mm_xor_si128(v, bias)), offset));
+    }
+    convertCountsScalar(counts + i, n - i, out + i);
+}
+
+static void mapPointsSse2(const double *x, const double *y, int n, double *out,
+                          double offsetX, double scaleX, double offsetY, double scaleY,
+                          double low, double high)
+{
+    const __m128d ox = _mm_set1_pd(offsetX), sx = _mm_set1_pd(scaleX);
+    const __m128d oy = _mm_set1_pd(offsetY), sy = _mm_set1_pd(scaleY);
+    const __m128d lo = _mm_set1_pd(low), hi = _mm_set1_pd(high);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d px = _mm_add_pd(ox, _mm_mul_pd(_mm_loadu_pd(x + i), sx));
+        __m128d py = _mm_sub_pd(oy, _mm_mul_pd(_mm_loadu_pd(y + i), sy));
+        px = _mm_min_pd(_mm_max_pd(px, lo), hi);
+        py = _mm_min_pd(_mm_max_pd(py, lo), hi);
+        _mm_storeu_pd(out + 2 * i, _mm_unpacklo_pd(px, py));
+        _mm_storeu_pd(out + 2 * i + 2, _mm_unpackhi_pd(px, py));
+    }
+    mapPointsScalar(x + i, y + i, n - i, out + 2 * i, offsetX, scaleX, offsetY, scaleY, low, high);
+}
+
+static void mapXSse2(const double *x, int n, double *out, double offsetX, double scaleX)
+{
+    const __m128d ox = _mm_set1_pd(offsetX), sx = _mm_set1_pd(scaleX);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(out + i, _mm_add_pd(ox, _mm_mul_pd(_mm_loadu_pd(x + i), sx)));
+    mapXScalar(x + i, n - i, out + i, offsetX, scaleX);
+}
+#endif
+
+#ifdef DATAVIEWER_HAVE_AVX2
+// each of these clears the upper halves of the ymm registers before
+// returning to sse code, which otherwise stalls on some cpus
+DATAVIEWER_TARGET_AVX2
+static void convertCountsAvx2(const unsigned int *counts, int n, double *out)
+{
+    const __m128i bias = _mm_set1_epi32(int(0x80000000u));
+    const __m256d offset = _mm256_set1_pd(2147483648.0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counts + i));
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(v, bias)), offset));
+    }
+    _mm256_zeroupper();
+    convertCountsScalar(counts + i, n - i, out + i);
+}
+
+// no fused multiply-add, so the results match the other kernels
+DATAVIEWER_TARGET_AVX2
+static void mapPointsAvx2(const double *x, const double *y, int n, double *out,
+                          double offsetX, double scaleX, double offsetY, double scaleY,
+                          double low, double high)
+{
+    const __m256d ox = _mm256_set1_pd(offsetX), sx = _mm256_set1_pd(scaleX);
+    const __m256d oy = _mm256_set1_pd(offsetY), sy = _mm256_set1_pd(scaleY);
+    const __m256d lo = _mm256_set1_pd(low), hi = _mm256_set1_pd(high);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d px = _mm256_add_pd(ox, _mm256_mul_pd(_mm256_loadu_pd(x + i), sx));
+        __m256d py = _mm256_sub_pd(oy, _mm256_mul_pd(_mm256_loadu_pd(y + i), sy));
+        px = _mm256_min_pd(_mm256_max_pd(px, lo), hi);
+        py = _mm256_min_pd(_mm256_max_pd(py, lo), hi);
+        // the unpacks pair up within each 128 bit lane: x0 y0 x2 y2, x1 y1 x3 y3
+        __m256d even = _mm256_unpacklo_pd(px, py);
+        __m256d odd = _mm256_unpackhi_pd(px, py);
+        _mm256_storeu_pd(out + 2 * i, _mm256_permute2f128_pd(even, odd, 0x20));
+        _mm256_storeu_pd(out + 2 * i + 4, _mm256_permute2f128_pd(even, odd, 0x31));
+    }
+    _mm256_zeroupper();
+    mapPointsScalar(x + i, y + i, n - i, out + 2 * i, offsetX, scaleX, offsetY, scaleY, low, high);
+}
+
+DATAVIEWER_TARGET_AVX2
+static void mapXAvx2(const double *x, int n, double *out, double offsetX, double scaleX)
+{
+    const __m256d ox = _mm256_set1_pd(offsetX), sx = _mm256_set1_pd(scaleX);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_add_pd(ox, _mm256_mul_pd(_mm256_loadu_pd(x + i), sx)));
+    _mm256_zeroupper();
+    mapXScalar(x + i, n - i, out + i, offsetX, scaleX);
+}
+#endif
+
+static bool cpuHasAvx2()
+{
+#if defined(DATAVIEWER_HAVE_AVX2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    // the os must save the ymm registers
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(DATAVIEWER_HAVE_AVX2)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+static int bestKernel()
+{
+    if (cpuHasAvx2())
+        return PixelTransform::Avx2;
+#ifdef DATAVIEWER_HAVE_SSE2
+    return PixelTransform::Sse2;
+#else
+    return PixelTransform::Scalar;
+#endif
+}
+
+static QAtomicInt &activeKernel()
+{
+    static QAtomicInt kernel(bestKernel());
+    return kernel;
+}
+
+PixelTransform::Kernel PixelTransform::kernel()
+{
+    return Kernel(activeKernel().load());
+}
+
+bool PixelTransform::isSupported(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Avx2:
+            return cpuHasAvx2();
+        case Sse2:
+#ifdef DATAVIEWER_HAVE_SSE2
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return true;
+    }
+}
+
+bool PixelTransform::setKernel(Kernel kernel)
+{
+    if (!isSupported(kernel))
+        return false;
+    activeKernel().store(kernel);
+    return true;
+}
+
+QString PixelTransform::kernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Avx2:
+            return "avx2";
+        case Sse2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+PixelTransform::PixelTransform(const QRect &rect, const PlotSettings &settings) :
+    logY(settings.logY)
+{
+    scaleX = (rect.width() - 1) / settings.spanX();
+    scaleY = (rect.height() - 1) / settings.spanY();
+    offsetX = rect.left() - settings.minX * scaleX;
+    offsetY = rect.bottom() + settings.minY * scaleY;
+}
+
+void PixelTransform::map(const double *x, const unsigned int *counts, int n, QPointF *out) const
+{
+    // QPointF is a pair of doubles unless qreal was configured as float
+    if (sizeof(qreal) != sizeof(double))
+    {
+        for (int i = 0; i < n; ++i)
+            out[i] = QPointF(mapX(x[i]), mapY(counts[i]));
+        return;
+    }
+
+    const Kernel active = kernel();
+    double y[chunkSize];
+    for (int first = 0; first < n; first += chunkSize)
+    {
+        const int size = qMin(chunkSize, n - first);
+        double *points = reinterpret_cast<double *>(out + first);
+        if (logY)
+        {
+            for (int i = 0; i < size; ++i)
+                y[i] = countLog(counts[first + i]);
+        }
+        switch (active)
+        {
+#ifdef DATAVIEWER_HAVE_AVX2
+            case Avx2:
+                if (!logY)
+                    convertCountsAvx2(counts + first, size, y);
+                mapPointsAvx2(x + first, y, size, points, offsetX, scaleX, offsetY, scaleY,
+                              -maxCoordinate, maxCoordinate);
+                break;
+#endif
+#ifdef DATAVIEWER_HAVE_SSE2
+            case Sse2:
+                if (!logY)
+                    convertCountsSse2(counts + first, size, y);
+                mapPointsSse2(x + first, y, size, points, offsetX, scaleX, offsetY, scaleY,
+                              -maxCoordinate, maxCoordinate);
+                break;
+#endif
+            default:
+                if (!logY)
+                    convertCountsScalar(counts + first, size, y);
+                mapPointsScalar(x + first, y, size, points, offsetX, scaleX, offsetY, scaleY,
+                                -maxCoordinate, maxCoordinate);
+        }
+    }
+}
+
+void PixelTransform::mapX(const double *x, int n, double *out) const
+{
+    switch (kernel())
+    {
+#ifdef DATAVIEWER_HAVE_AVX2
+        case Avx2:
+            mapXAvx2(x, n, out, offsetX, scaleX);
+            break;
+#endif
+#ifdef DATAVIEWER_HAVE_SSE2
+        case Sse2:
+            mapXSse2(x, n, out, offsetX, scaleX);
+            break;
+#endif
+        default:
+            mapXScalar(x, n, out, offsetX, scaleX);
+    }
+}
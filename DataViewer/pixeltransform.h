@@ -0,0 +1,53 @@
+#ifndef PIXELTRANSFORM_H
+#define PIXELTRANSFORM_H
+
+#include <QPointF>
+#include <QRect>
+#include <QString>
+#include <cmath>
+
+#include "plotrenderer.h"
+
+// Maps data to pixel coordinates of a plot area for a run of points at
+// a time, with a vector kernel chosen at runtime: AVX2 or SSE2 where the
+// cpu has them, plain C++ otherwise. All kernels give the same results.
+// With a log y axis the plot settings hold decades, see countLog().
+// Coordinates are clamped to +-maxCoordinate, far outside any widget but
+// within what the raster engine handles.
+class PixelTransform
+{
+public:
+    enum Kernel { Scalar, Sse2, Avx2 };
+    enum { maxCoordinate = 1 << 22 };
+
+    PixelTransform(const QRect &rect, const PlotSettings &settings);
+
+    double mapX(double x) const { return clamp(offsetX + x * scaleX); };
+    double mapY(unsigned int count) const {
+        return clamp(offsetY - (logY ? countLog(count) : double(count)) * scaleY);
+    };
+
+    // the points (x[i], counts[i]) into out
+    void map(const double *x, const unsigned int *counts, int n, QPointF *out) const;
+    // the x coordinates alone, not clamped, to find the pixel column of each point
+    void mapX(const double *x, int n, double *out) const;
+
+    // a count on the log axis, in decades; zero goes one decade below a single count
+    static double countLog(unsigned int count) { return count > 0 ? std::log10(double(count)) : -1.0; };
+
+    // the kernel in use, the best one the cpu supports unless set
+    static Kernel kernel();
+    // false if the cpu lacks the instructions
+    static bool setKernel(Kernel kernel);
+    static bool isSupported(Kernel kernel);
+    static QString kernelName(Kernel kernel);
+
+private:
+    double clamp(double v) const { return qBound(-double(maxCoordinate), v, double(maxCoordinate)); };
+
+    double offsetX, scaleX;
+    double offsetY, scaleY;
+    bool logY;
+};
+
+#endif // PIXELTRANSFORM_H
@@ -0,0 +1,397 @@
+#include <cmath>
+#include <algorithm>
+
+#include "plotrenderer.h"
+#include "pixeltransform.h"
+#include "tracer.h"
+
+PlotRenderer::PlotRenderer() :
+    labelX("labelX"), labelY("labelY")
+{
+}
+
+void PlotRenderer::setData(const TableSnapshot &data)
+{
+    this->data = data;
+    labelX=data.header(0);
+    // with several count columns their names go into the legend instead
+    if(data.countColumnCount()==1)
+        labelY=data.header(1);
+    else
+        labelY=QObject::tr("Counts");
+}
+
+int PlotRenderer::render(QPainter *painter, const QRect &rect, const PlotSettings &settings) const
+{
+    if (!rect.isValid())
+        return 0;
+    drawGrid(painter, rect, settings);
+    int points = drawCurves(painter, rect, settings, rect);
+    drawLegend(painter, rect);
+    return points;
+}
+
+// The y range is shared by all count columns; the min/max of each one
+// comes from the model in O(log n). Empty spans are widened by one, so
+// the axes stay finite.
+PlotSettings PlotRenderer::dataExtents(const TableModel *model, bool logY)
+{
+    PlotSettings extents(0,0,10,10);
+    extents.logY=logY;
+    if(model->rowCount()>0)
+    {
+        model->column1Range(extents.minX, extents.maxX);
+        for(int series=0; series<model->countColumnCount(); series++)
+        {
+            unsigned int minY, maxY;
+            model->countRange(series, 0, model->rowCount(), minY, maxY);
+            if(series==0 || minY<extents.minY)
+                extents.minY=minY;
+            if(series==0 || maxY>extents.maxY)
+                extents.maxY=maxY;
+        }
+        if(logY)
+        {
+            extents.minY=PixelTransform::countLog(static_cast<unsigned int>(extents.minY));
+            extents.maxY=PixelTransform::countLog(static_cast<unsigned int>(extents.maxY));
+        }
+        if(extents.maxX<=extents.minX)
+            extents.maxX=extents.minX+1;
+        if(extents.maxY<=extents.minY)
+            extents.maxY=extents.minY+1;
+    }
+    return extents;
+}
+
+void PlotRenderer::drawGrid(QPainter *painter, const QRect &rect,
+                            const PlotSettings &settings) const
+{
+    TRACE_SCOPE("PlotRenderer::drawGrid");
+    QPen quiteDark = palette.dark().color().light();
+    QPen light = palette.light().color();
+    for (int i = 0; i <= settings.numXTicks; ++i)
+    {
+        int x = rect.left() + (i * (rect.width() - 1)
+                               / settings.numXTicks);
+        double label = settings.minX + (i * settings.spanX()
+                                        / settings.numXTicks);
+        painter->setPen(quiteDark);
+        painter->drawLine(x, rect.top(), x, rect.bottom());
+        painter->setPen(light);
+        painter->drawLine(x, rect.bottom(), x, rect.bottom() + 5);
+        painter->drawText(x - 50, rect.bottom() + 5, 100, 15,
+                          Qt::AlignHCenter | Qt::AlignTop,
+                          QString::number(label));
+    }
+
+    painter->drawText(rect.center().x(), rect.bottom() + 30,
+                      labelX);
+
+    for (int j = 0; j <= settings.numYTicks; ++j)
+    {
+        int y = rect.bottom() - (j * (rect.height() - 1)
+                                 / settings.numYTicks);
+        double label = settings.minY + (j * settings.spanY()
+                                        / settings.numYTicks);
+        painter->setPen(quiteDark);
+        painter->drawLine(rect.left(), y, rect.right(), y);
+        painter->setPen(light);
+        painter->drawLine(rect.left() - 5, y, rect.left(), y);
+        painter->drawText(rect.left() - Margin, y - 10, Margin - 5, 20,
+                          Qt::AlignRight | Qt::AlignVCenter,
+                          settings.logY ? QString::number(std::pow(10.0, label), 'g', 3)
+                                        : QString::number(label));
+    }
+    painter->drawRect(rect.adjusted(0, 0, -1, -1));
+
+    // ugly draw label Y
+    painter->translate(rect.left() - 30, rect.center().y());
+    painter->rotate(270);
+    painter->drawText(0,0,labelY);
+    painter->resetTransform();
+}
+
+
+// Reduce the points of [first, last) to at most four vertices per pixel
+// column: the first, lowest, highest and last point falling into it.
+// The polyline through them covers the same pixels as the full curve,
+// so peaks stay intact while the cost of drawing depends on the plot width.
+// The pixel x of the points is computed a block at a time by the vector
+// kernel, with the block unpacked if a column is packed or computed;
+// the vertices are left in data units.
+static void decimateCurve(const TableSnapshot &data, int series, int first, int last,
+                          const PixelTransform &transform,
+                          QVector<double> &vertexX, QVector<unsigned int> &vertexY)
+{
+    const ColumnSpan<double> dataX = data.column1();
+    const int blockSize = 1024;
+    double pixelX[blockSize];
+    double bufferX[blockSize];
+    unsigned int buffer[blockSize];
+    const unsigned int *blockY = 0;
+    int blockFirst = first, blockLast = first;
+
+    vertexX.clear();
+    vertexY.clear();
+
+    bool open = false;
+    double column = 0;
+    int firstIndex = first, minIndex = first, maxIndex = first, lastIndex = first;
+    unsigned int firstY = 0, minY = 0, maxY = 0, lastY = 0;
+    for (int j = first; j <= last; ++j)
+    {
+        if (j < last && j == blockLast)
+        {
+            blockFirst = j;
+            blockLast = qMin(j + blockSize, last);
+            transform.mapX(data.column1Rows(j, blockLast, bufferX), blockLast - j, pixelX);
+            blockY = data.countRows(series, j, blockLast, buffer);
+        }
+        const unsigned int y = j < last ? blockY[j - blockFirst] : 0;
+        if (j < last && open && std::floor(pixelX[j - blockFirst]) == column)
+        {
+            if (y < minY)
+            {
+                minIndex = j;
+                minY = y;
+            }
+            else if (y > maxY)
+            {
+                maxIndex = j;
+                maxY = y;
+            }
+            lastIndex = j;
+            lastY = y;
+            continue;
+        }
+
+        // the column is complete, or the points ended
+        if (open)
+        {
+            const bool minFirst = minIndex < maxIndex;
+            int vertices[4] = { firstIndex, qMin(minIndex, maxIndex), qMax(minIndex, maxIndex), lastIndex };
+            unsigned int values[4] = { firstY, minFirst ? minY : maxY, minFirst ? maxY : minY, lastY };
+            for (int k = 0; k < 4; ++k)
+            {
+                if (k > 0 && vertices[k] == vertices[k - 1])
+                    continue;
+                vertexX.append(dataX[vertices[k]]);
+                vertexY.append(values[k]);
+            }
+        }
+        if (j < last)
+        {
+            open = true;
+            column = std::floor(pixelX[j - blockFirst]);
+            firstIndex = minIndex = maxIndex = lastIndex = j;
+            firstY = minY = maxY = lastY = y;
+        }
+    }
+}
+
+// For sorted data the rows of each pixel column are found without walking
+// every point: on an evenly spaced column1 from its calibration, else by
+// galloping over column1 from the previous column. bounds gets the first
+// row of every pixel column, followed by last. This only depends on
+// column1, so it is done once for all curves.
+static void pixelColumnBounds(const TableSnapshot &data, int first, int last,
+                              const QRect &rect, const PlotSettings &settings,
+                              QVector<int> &bounds)
+{
+    const ColumnSpan<double> dataX = data.column1();
+    const UniformAxis &axis = data.column1Axis();
+    const double scaleX = (rect.width() - 1) / settings.spanX();
+    const double left = rect.left() - settings.minX * scaleX;
+
+    bounds.clear();
+    bounds.reserve(rect.width() + 3);
+
+    int j = first;
+    while (j < last)
+    {
+        bounds.append(j);
+        // first row at or beyond the next pixel column boundary
+        const double column = std::floor(left + dataX[j] * scaleX);
+        const double boundary = (column + 1 - left) / scaleX;
+        if (axis.isUniform())
+        {
+            j = qBound(j + 1, axis.lowerBound(dataX, boundary), last);
+            continue;
+        }
+        int step = 1;
+        int low = j + 1, high = j + 1;
+        while (high < last && dataX[high] < boundary)
+        {
+            low = high + 1;
+            high = qMin(high + step, last);
+            step *= 2;
+        }
+        j = std::lower_bound(dataX.begin() + low, dataX.begin() + high, boundary)
+                - dataX.begin();
+    }
+    bounds.append(last);
+}
+
+// Same reduction as decimateCurve() for one count column of sorted data,
+// over the pixel columns from pixelColumnBounds(). The min/max of a pixel
+// column comes from the model's pyramid index, so the cost is about
+// O(width * log(n / width)) whatever the zoom level.
+static void decimateSortedCurve(const TableSnapshot &data, int series, const QVector<int> &bounds,
+                                QVector<double> &vertexX, QVector<unsigned int> &vertexY)
+{
+    const ColumnSpan<double> dataX = data.column1();
+
+    vertexX.clear();
+    vertexY.clear();
+    vertexX.reserve(4 * bounds.size());
+    vertexY.reserve(4 * bounds.size());
+
+    for (int i = 0; i + 1 < bounds.size(); ++i)
+    {
+        const int j = bounds.at(i);
+        const int end = bounds.at(i + 1);
+        const unsigned int firstY = data.count(series, j);
+        const unsigned int lastY = data.count(series, end - 1);
+        vertexX.append(dataX[j]);
+        vertexY.append(firstY);
+        if (end - j > 2)
+        {
+            unsigned int minY, maxY;
+            data.countRange(series, j, end, minY, maxY);
+            // go down first when the column ends lower than it started
+            bool falling = lastY < firstY;
+            vertexX.append(dataX[j]);
+            vertexY.append(falling ? maxY : minY);
+            vertexX.append(dataX[end - 1]);
+            vertexY.append(falling ? minY : maxY);
+        }
+        if (end - j > 1)
+        {
+            vertexX.append(dataX[end - 1]);
+            vertexY.append(lastY);
+        }
+    }
+}
+
+// one colour per count column, the first one in the familiar yellow
+static QColor seriesColor(int series)
+{
+    static const QColor colorForIds[6] = {
+        Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow
+    };
+    return colorForIds[(series + 5) % 6];
+}
+
+int PlotRenderer::drawCurves(QPainter *painter, const QRect &rect,
+                             const PlotSettings &settings, const QRect &clip) const
+{
+    TRACE_SCOPE("PlotRenderer::drawCurves");
+    painter->save();
+    painter->setClipRect(rect.adjusted(+1, +1, -1, -1) & clip);
+
+    ColumnSpan<double> dataX = data.column1();
+
+    // only the rows inside the clip, plus one on each side so the curve
+    // enters and leaves it; the pixel columns are those of the whole rect
+    int first = 0, last = dataX.size();
+    QVector<int> bounds;
+    if (data.isSorted())
+    {
+        const double scaleX = (rect.width() - 1) / settings.spanX();
+        const double minX = settings.minX + (clip.left() - 1 - rect.left()) / scaleX;
+        const double maxX = settings.minX + (clip.right() + 1 - rect.left()) / scaleX;
+        first = qMax(data.lowerBound(minX) - 1, 0);
+        last = qMin(data.upperBound(maxX) + 1, dataX.size());
+        pixelColumnBounds(data, first, last, rect, settings, bounds);
+    }
+
+    const PixelTransform transform(rect, settings);
+    const int seriesCount = data.countColumnCount();
+    QVector<double> vertexX;
+    QVector<unsigned int> vertexY;
+    QPolygonF polyline;
+    int points = 0;
+    for (int series = 0; series < seriesCount; ++series)
+    {
+        if (data.isSorted())
+            decimateSortedCurve(data, series, bounds, vertexX, vertexY);
+        else
+            decimateCurve(data, series, first, last, transform, vertexX, vertexY);
+        polyline.resize(vertexX.size());
+        transform.map(vertexX.constData(), vertexY.constData(), vertexX.size(), polyline.data());
+
+        painter->setPen(seriesColor(series));
+        painter->drawPolyline(polyline);
+        points += polyline.size();
+    }
+    painter->restore();
+    return points;
+}
+
+void PlotRenderer::drawLegend(QPainter *painter, const QRect &rect) const
+{
+    const int seriesCount = data.countColumnCount();
+    if (seriesCount < 2)
+        return;
+    const int lineHeight = painter->fontMetrics().height();
+    for (int series = 0; series < seriesCount; ++series)
+    {
+        int y = rect.top() + 10 + series * lineHeight;
+        painter->setPen(seriesColor(series));
+        painter->drawLine(rect.left() + 10, y, rect.left() + 30, y);
+        painter->drawText(rect.left() + 35, y - lineHeight / 2, rect.width() - 45, lineHeight,
+                          Qt::AlignLeft | Qt::AlignVCenter, data.header(series + 1));
+    }
+}
+
+PlotSettings::PlotSettings(double minX, double minY, double maxX, double maxY):
+minX(minX), minY(minY), maxX(maxX), maxY(maxY), numXTicks(5), numYTicks(5), logY(false)
+{
+}
+
+bool PlotSettings::operator==(const PlotSettings &other) const
+{
+    return minX == other.minX && maxX == other.maxX && minY == other.minY && maxY == other.maxY
+            && numXTicks == other.numXTicks && numYTicks == other.numYTicks && logY == other.logY;
+}
+
+void PlotSettings::scroll(int dx, int dy)
+{
+    double stepX = spanX() / numXTicks;
+    minX += dx * stepX;
+    maxX += dx * stepX;
+    double stepY = spanY() / numYTicks;
+    minY += dy * stepY;
+    maxY += dy * stepY;
+}
+
+void PlotSettings::adjust()
+{
+    adjustAxis(minX, maxX, numXTicks);
+    adjustAxis(minY, maxY, numYTicks);
+}
+
+// ajust Axis to provide a better view
+void PlotSettings::adjustAxis(double &min, double &max,
+                              int &numTicks)
+{
+    const int MinTicks = 4;
+    double grossStep = (max - min) / MinTicks;
+    double step = pow(10.0, floor(log10(grossStep)));
+    if (5 * step < grossStep)
+    {
+        step *= 5;
+    }
+    else if (2 * step < grossStep)
+    {
+        step *= 2;
+    }
+
+    numTicks = int(ceil(max / step) - floor(min / step));
+    if (numTicks < MinTicks)
+        numTicks = MinTicks;
+
+    min = floor(min / step) * step;
+    max = ceil(max / step) * step;
+}
+
@@ -0,0 +1,68 @@
+#ifndef PLOTRENDERER_H
+#define PLOTRENDERER_H
+
+#include <QPainter>
+#include <QPalette>
+#include <QRect>
+#include <QString>
+
+#include "tablemodel.h"
+
+class PlotSettings
+{
+public:
+    PlotSettings(double minX=0, double minY=0,double maxX=10,double maxY=10);
+    void scroll(int dx, int dy);
+    void adjust();
+    double spanX() const { return maxX - minX; }
+    double spanY() const { return maxY - minY; }
+    bool operator==(const PlotSettings &other) const;
+    bool operator!=(const PlotSettings &other) const { return !(*this == other); }
+    double minX, minY, maxX, maxY;
+    int numXTicks, numYTicks;
+    // counts on a log10 axis, minY and maxY are then in decades
+    bool logY;
+private:
+    static void adjustAxis(double &min, double &max, int &numTicks);
+};
+
+// Draws the grid, the axis labels and the curves of a model onto any
+// paint device. It holds no widget and reads a snapshot of the model,
+// so GraphView's render thread and the batch mode share it, and it can
+// draw into a QImage outside the gui thread.
+class PlotRenderer
+{
+public:
+    enum { Margin = 50 };
+
+    PlotRenderer();
+
+    // the axis labels come from the headers of the data
+    void setData(const TableSnapshot &data);
+    void setModel(const TableModel *model) { setData(model->snapshot()); };
+    void setPalette(const QPalette &palette) { this->palette = palette; };
+
+    // rect is the plot area, the labels go into the margin around it;
+    // returns the number of curve vertices drawn
+    int render(QPainter *painter, const QRect &rect, const PlotSettings &settings) const;
+
+    // the layers render() draws, for callers that compose them themselves:
+    // the curves are drawn only where they cross clip, but at the
+    // positions they have in the whole rect
+    void drawGrid(QPainter *painter, const QRect &rect, const PlotSettings &settings) const;
+    int drawCurves(QPainter *painter, const QRect &rect, const PlotSettings &settings,
+                   const QRect &clip) const;
+    // names of the count columns, when there are several
+    void drawLegend(QPainter *painter, const QRect &rect) const;
+
+    // raw bounds of the model data, all count columns on one y range
+    static PlotSettings dataExtents(const TableModel *model, bool logY = false);
+
+private:
+
+    TableSnapshot data;
+    QPalette palette;
+    QString labelX,labelY;
+};
+
+#endif // PLOTRENDERER_H
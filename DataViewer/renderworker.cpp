@@ -0,0 +1,143 @@
+#include <QElapsedTimer>
+#include <QPainter>
+#include <cmath>
+
+#include "renderworker.h"
+#include "tracer.h"
+
+RenderWorker::RenderWorker(QObject *parent) :
+    QObject(parent), activeFrame(0), lastId(0), curveVersion(-1)
+{
+    qRegisterMetaType<RenderJob>();
+    qRegisterMetaType<PlotSettings>();
+}
+
+int RenderWorker::requestFrame()
+{
+    int id = lastId.fetchAndAddOrdered(1) + 1;
+    activeFrame.store(id);
+    return id;
+}
+
+void RenderWorker::cancel()
+{
+    activeFrame.store(0);
+}
+
+// A frame that has started is finished even if a newer one is requested
+// meanwhile: it is still closer to the view than the one on screen, and
+// under continuous panning something must get drawn.
+void RenderWorker::render(int id, const RenderJob &job)
+{
+    if (!isActive(id))
+        return;
+    TRACE_SCOPE("RenderWorker::render");
+    QElapsedTimer timer;
+    timer.start();
+
+    // a widget that is not laid out yet gets an empty frame
+    QImage image(job.size, QImage::Format_ARGB32_Premultiplied);
+    int points = 0;
+    if (!image.isNull())
+    {
+        image.fill(job.palette.dark().color());
+        const int margin = PlotRenderer::Margin;
+        const QRect plot(margin, margin, image.width() - 2 * margin, image.height() - 2 * margin);
+        if (plot.isValid())
+        {
+            PlotRenderer renderer;
+            renderer.setData(job.data);
+            renderer.setPalette(job.palette);
+            points = updateCurves(renderer, plot.size(), job);
+
+            QPainter painter(&image);
+            painter.setFont(job.font);
+            renderer.drawGrid(&painter, plot, job.settings);
+            painter.drawImage(plot.topLeft(), curves);
+            renderer.drawLegend(&painter, plot);
+        }
+    }
+
+    emit rendered(id, image, job.settings, points, timer.nsecsElapsed());
+}
+
+// spans of a pan differ only by rounding
+static bool sameSpan(double a, double b)
+{
+    return std::fabs(a - b) <= 1e-9 * std::fabs(b);
+}
+
+// Brings the curve layer to the view of job and returns the vertices
+// drawn for it. A pan over unchanged data moves the layer by whole pixels
+// (see scrollCurves()), anything else draws it anew.
+int RenderWorker::updateCurves(const PlotRenderer &renderer, const QSize &size, const RenderJob &job)
+{
+    const PlotSettings &settings = job.settings;
+    if (curves.size() == size && curveVersion == job.dataVersion
+            && curveSettings.logY == settings.logY
+            && sameSpan(curveSettings.spanX(), settings.spanX())
+            && sameSpan(curveSettings.spanY(), settings.spanY()))
+    {
+        // beyond half the plot a full redraw costs about the same
+        const double shiftX = std::floor((settings.minX - curveSettings.minX)
+                                         * (size.width() - 1) / settings.spanX() + 0.5);
+        const double shiftY = std::floor((settings.minY - curveSettings.minY)
+                                         * (size.height() - 1) / settings.spanY() + 0.5);
+        if (std::fabs(shiftX) < size.width() / 2 && std::fabs(shiftY) < size.height() / 2)
+            return scrollCurves(renderer, int(shiftX), int(shiftY), job);
+    }
+
+    TRACE_SCOPE("RenderWorker::drawCurves");
+    curves = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    curves.fill(Qt::transparent);
+    curveSettings = settings;
+    curveVersion = job.dataVersion;
+    const QRect rect(QPoint(0, 0), size);
+    QPainter painter(&curves);
+    return renderer.drawCurves(&painter, rect, settings, rect);
+}
+
+// The layer keeps its own pixel grid: it moves by whole pixels and its
+// view by the matching data distance, which stays within half a pixel of
+// the requested view, so the error does not add up over many pans.
+// The strips that come into view are widened by the frame of the plot
+// area, which the curves leave out.
+int RenderWorker::scrollCurves(const PlotRenderer &renderer, int shiftX, int shiftY,
+                               const RenderJob &job)
+{
+    if (shiftX == 0 && shiftY == 0)
+        return 0;
+    TRACE_SCOPE("RenderWorker::scrollCurves");
+    const int width = curves.width();
+    const int height = curves.height();
+    const double scaleX = (width - 1) / job.settings.spanX();
+    const double scaleY = (height - 1) / job.settings.spanY();
+    curveSettings.minX += shiftX / scaleX;
+    curveSettings.maxX = curveSettings.minX + job.settings.spanX();
+    curveSettings.minY += shiftY / scaleY;
+    curveSettings.maxY = curveSettings.minY + job.settings.spanY();
+
+    QImage moved(curves.size(), curves.format());
+    moved.fill(Qt::transparent);
+    QPainter painter(&moved);
+    painter.drawImage(-shiftX, shiftY, curves);
+
+    const int overlap = 2;
+    QVector<QRect> strips;
+    if (shiftX > 0)
+        strips.append(QRect(width - shiftX - overlap, 0, shiftX + overlap, height));
+    else if (shiftX < 0)
+        strips.append(QRect(0, 0, overlap - shiftX, height));
+    if (shiftY > 0)
+        strips.append(QRect(0, 0, width, shiftY + overlap));
+    else if (shiftY < 0)
+        strips.append(QRect(0, height + shiftY - overlap, width, overlap - shiftY));
+
+    const QRect rect(QPoint(0, 0), curves.size());
+    int points = 0;
+    for (int i = 0; i < strips.size(); ++i)
+        points += renderer.drawCurves(&painter, rect, curveSettings, strips.at(i));
+    painter.end();
+    curves = moved;
+    return points;
+}
@@ -0,0 +1,71 @@
+#ifndef RENDERWORKER_H
+#define RENDERWORKER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QFont>
+#include <QImage>
+#include <QPalette>
+#include <QSize>
+
+#include "plotrenderer.h"
+
+// everything a frame is drawn from, copied on the gui thread
+class RenderJob
+{
+public:
+    RenderJob() : dataVersion(0) {};
+
+    TableSnapshot data;
+    int dataVersion;                // changes whenever the data does
+    PlotSettings settings;
+    QSize size;
+    QPalette palette;
+    QFont font;
+};
+
+// Draws GraphView frames into a QImage on a worker thread.
+// Every frame has an id, and requesting one supersedes all earlier ones:
+// a request that is no longer the active one when the thread gets to it
+// is dropped, so however fast the view changes only the latest state is
+// drawn.
+// The curves are kept in a layer of their own, the grid and labels are
+// drawn over again for every frame. When the view is only panned over
+// unchanged data, the layer is moved and just the strips that came into
+// view are drawn, however many points the rest of it shows.
+class RenderWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RenderWorker(QObject *parent = 0);
+
+    // thread safe, called from the GUI thread
+    int requestFrame();
+    void cancel();
+
+signals:
+    void rendered(int id, const QImage &image, const PlotSettings &settings,
+                  int points, qint64 nsecs);
+
+public slots:
+    // runs on the worker thread, id comes from requestFrame()
+    void render(int id, const RenderJob &job);
+
+private:
+    bool isActive(int id) const { return activeFrame.load()==id; };
+    int updateCurves(const PlotRenderer &renderer, const QSize &size, const RenderJob &job);
+    int scrollCurves(const PlotRenderer &renderer, int shiftX, int shiftY, const RenderJob &job);
+
+    QAtomicInt activeFrame;
+    QAtomicInt lastId;
+
+    // curve layer of the plot area, used on the worker thread only
+    QImage curves;
+    PlotSettings curveSettings;     // the view its pixels are drawn for
+    int curveVersion;
+};
+
+Q_DECLARE_METATYPE(RenderJob)
+Q_DECLARE_METATYPE(PlotSettings)
+
+#endif // RENDERWORKER_H
@@ -0,0 +1,39 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// compile time detection of the vector instruction sets we use
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DATAVIEWER_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 code is compiled per function, marked DATAVIEWER_TARGET_AVX2, and
+// only called after a runtime check of the cpu
+#if defined(DATAVIEWER_HAVE_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define DATAVIEWER_HAVE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define DATAVIEWER_TARGET_AVX2
+#else
+#define DATAVIEWER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// index of the lowest set bit, mask must not be 0
+inline int countTrailingZeros(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return int(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+#endif // SIMD_H
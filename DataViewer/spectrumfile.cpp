@@ -0,0 +1,309 @@
+#include <QFile>
+#include <QObject>
+#include <QSaveFile>
+#include <QVector>
+#include <climits>
+#include <cstring>
+
+#include "spectrumfile.h"
+#include "tracer.h"
+
+static const char magic[8] = { 'D', 'V', 'S', 'P', 'E', 'C', 0, 1 };
+static const quint32 currentVersion = 1;
+static const qint64 dataAlignment = 64;
+static const quint32 maxColumns = 1024;
+
+struct FileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 columnCount;
+    quint64 rowCount;
+    quint64 checksum;       // over the column arrays
+};
+
+struct ColumnHeader
+{
+    quint32 type;           // SpectrumFile::ColumnType
+    quint32 nameSize;       // bytes of UTF-8 name that follow, before padding
+    quint64 offset;         // of the array from the start of the file
+};
+
+static qint64 alignUp(qint64 value, qint64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static int elementSize(quint32 type)
+{
+    switch (type)
+    {
+        case SpectrumFile::Float64:
+            return 8;
+        case SpectrumFile::UInt32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+bool SpectrumFile::isSpectrumFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    char buffer[sizeof(magic)];
+    return file.read(buffer, sizeof(buffer)) == sizeof(buffer)
+            && std::memcmp(buffer, magic, sizeof(magic)) == 0;
+}
+
+// 64 bit multiply-xorshift hash, 8 bytes per step
+quint64 SpectrumFile::checksum(const char *data, qint64 size, quint64 seed)
+{
+    const quint64 prime = Q_UINT64_C(0x9E3779B97F4A7C15);
+    quint64 hash = seed ^ (quint64(size) * prime);
+    quint64 word;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        std::memcpy(&word, data, 8);
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 31;
+    }
+    if (size > 0)
+    {
+        word = 0;
+        std::memcpy(&word, data, size_t(size));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 31;
+    }
+    return hash;
+}
+
+bool SpectrumFile::read(const QString &fileName, QStringList &header, ColumnBlock &rows,
+                        QString &errorString)
+{
+    TRACE_SCOPE("SpectrumFile::read");
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    errorString = QObject::tr("Spectrum files are only supported on little endian machines");
+    return false;
+#endif
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        errorString = file.errorString();
+        return false;
+    }
+
+    const qint64 size = file.size();
+    QByteArray buffer;
+    const char *data = reinterpret_cast<const char *>(file.map(0, size));
+    if (data == 0)
+    {
+        buffer = file.readAll();
+        data = buffer.constData();
+    }
+
+    FileHeader fileHeader;
+    if (size < qint64(sizeof(fileHeader)))
+    {
+        errorString = QObject::tr("File is too short");
+        return false;
+    }
+    std::memcpy(&fileHeader, data, sizeof(fileHeader));
+    if (std::memcmp(fileHeader.magic, magic, sizeof(magic)) != 0)
+    {
+        errorString = QObject::tr("Not a DataViewer spectrum file");
+        return false;
+    }
+    if (fileHeader.version != currentVersion)
+    {
+        errorString = QObject::tr("Unsupported spectrum file version %1").arg(fileHeader.version);
+        return false;
+    }
+    if (fileHeader.columnCount < 2 || fileHeader.columnCount > maxColumns)
+    {
+        errorString = QObject::tr("Unsupported number of columns %1").arg(fileHeader.columnCount);
+        return false;
+    }
+    if (fileHeader.rowCount > quint64(INT_MAX))
+    {
+        errorString = QObject::tr("Too many rows");
+        return false;
+    }
+    const int rowCount = int(fileHeader.rowCount);
+    const int columnCount = int(fileHeader.columnCount);
+
+    // column descriptors: the energy, then the count channels
+    QVector<const char *> columnData(columnCount);
+    QVector<qint64> columnSize(columnCount);
+    qint64 pos = sizeof(fileHeader);
+    header.clear();
+    for (int column = 0; column < columnCount; ++column)
+    {
+        ColumnHeader columnHeader;
+        if (pos + qint64(sizeof(columnHeader)) > size)
+        {
+            errorString = QObject::tr("Truncated column header");
+            return false;
+        }
+        std::memcpy(&columnHeader, data + pos, sizeof(columnHeader));
+        pos += sizeof(columnHeader);
+
+        if (columnHeader.type != quint32(column == 0 ? Float64 : UInt32))
+        {
+            errorString = QObject::tr("Unexpected type of column %1").arg(column + 1);
+            return false;
+        }
+        if (pos + qint64(columnHeader.nameSize) > size)
+        {
+            errorString = QObject::tr("Truncated column header");
+            return false;
+        }
+        header.append(QString::fromUtf8(data + pos, int(columnHeader.nameSize)));
+        pos = alignUp(pos + columnHeader.nameSize, 8);
+
+        columnSize[column] = qint64(rowCount) * elementSize(columnHeader.type);
+        if (columnHeader.offset % dataAlignment != 0
+                || columnHeader.offset > quint64(size)
+                || quint64(columnSize[column]) > quint64(size) - columnHeader.offset)
+        {
+            errorString = QObject::tr("Column %1 is outside of the file").arg(column + 1);
+            return false;
+        }
+        columnData[column] = data + columnHeader.offset;
+    }
+
+    quint64 sum = 0;
+    for (int column = 0; column < columnCount; ++column)
+        sum = checksum(columnData[column], columnSize[column], sum);
+    if (sum != fileHeader.checksum)
+    {
+        errorString = QObject::tr("Checksum mismatch, the file is damaged");
+        return false;
+    }
+
+    rows = ColumnBlock(columnCount - 1);
+    rows.column1.resize(rowCount);
+    std::memcpy(rows.column1.data(), columnData[0], size_t(columnSize[0]));
+    for (int column = 1; column < columnCount; ++column)
+    {
+        rows.counts[column - 1].resize(rowCount);
+        std::memcpy(rows.counts[column - 1].data(), columnData[column], size_t(columnSize[column]));
+    }
+    return true;
+}
+
+// the array of a column as it goes into the file; a packed count column
+// is unpacked into buffer and a computed column1 into values, so only one
+// of them is unpacked at a time
+static const char *columnBytes(const ColumnBlock &rows, int column, QVector<unsigned int> &buffer,
+                               QVector<double> &values)
+{
+    if (column == 0 && rows.isColumn1Computed())
+    {
+        values.resize(rows.size());
+        rows.column1Rows(0, rows.size(), values.data());
+        return reinterpret_cast<const char *>(values.constData());
+    }
+    if (column == 0)
+        return reinterpret_cast<const char *>(rows.column1.constData());
+    if (!rows.isPacked(column - 1))
+        return reinterpret_cast<const char *>(rows.counts.at(column - 1).constData());
+    buffer = rows.packed.at(column - 1).toVector();
+    return reinterpret_cast<const char *>(buffer.constData());
+}
+
+bool SpectrumFile::write(const QString &fileName, const QStringList &header,
+                         const ColumnBlock &rows, QString &errorString)
+{
+    TRACE_SCOPE("SpectrumFile::write");
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    errorString = QObject::tr("Spectrum files are only supported on little endian machines");
+    return false;
+#endif
+    // written next to the old file and renamed over it when complete
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        errorString = file.errorString();
+        return false;
+    }
+
+    const int columnCount = rows.counts.size() + 1;
+    QVector<quint32> types(columnCount);
+    QVector<qint64> columnSize(columnCount);
+    types[0] = Float64;
+    columnSize[0] = qint64(rows.size()) * sizeof(double);
+    for (int column = 1; column < columnCount; ++column)
+    {
+        types[column] = UInt32;
+        columnSize[column] = qint64(rows.size()) * sizeof(unsigned int);
+    }
+
+    // header block, the arrays follow at aligned offsets
+    QByteArray head(sizeof(FileHeader), '\0');
+    qint64 offset = 0;
+    QVector<QByteArray> names(columnCount);
+    for (int column = 0; column < columnCount; ++column)
+    {
+        names[column] = header.value(column).toUtf8();
+        offset += sizeof(ColumnHeader) + alignUp(names[column].size(), 8);
+    }
+    offset = alignUp(offset + sizeof(FileHeader), dataAlignment);
+
+    quint64 sum = 0;
+    for (int column = 0; column < columnCount; ++column)
+    {
+        ColumnHeader columnHeader;
+        columnHeader.type = types[column];
+        columnHeader.nameSize = names[column].size();
+        columnHeader.offset = offset;
+        head.append(reinterpret_cast<const char *>(&columnHeader), sizeof(columnHeader));
+        head.append(names[column]);
+        head.append(QByteArray(alignUp(names[column].size(), 8) - names[column].size(), '\0'));
+
+        offset = alignUp(offset + columnSize[column], dataAlignment);
+        QVector<unsigned int> buffer;
+        QVector<double> values;
+        sum = checksum(columnBytes(rows, column, buffer, values), columnSize[column], sum);
+    }
+    head.append(QByteArray(alignUp(head.size(), dataAlignment) - head.size(), '\0'));
+
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, magic, sizeof(magic));
+    fileHeader.version = currentVersion;
+    fileHeader.columnCount = columnCount;
+    fileHeader.rowCount = rows.size();
+    fileHeader.checksum = sum;
+    std::memcpy(head.data(), &fileHeader, sizeof(fileHeader));
+
+    // large sequential writes straight from the column arrays
+    const qint64 chunkSize = 16 * 1024 * 1024;
+    bool ok = file.write(head) == head.size();
+    for (int column = 0; ok && column < columnCount; ++column)
+    {
+        QVector<unsigned int> buffer;
+        QVector<double> values;
+        const char *data = columnBytes(rows, column, buffer, values);
+        for (qint64 done = 0; ok && done < columnSize[column]; done += chunkSize)
+        {
+            qint64 length = qMin(chunkSize, columnSize[column] - done);
+            ok = file.write(data + done, length) == length;
+        }
+        qint64 padding = alignUp(columnSize[column], dataAlignment) - columnSize[column];
+        if (ok && column + 1 < columnCount && padding > 0)
+            ok = file.write(QByteArray(padding, '\0')) == padding;
+    }
+    if (!ok)
+    {
+        errorString = file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit())
+    {
+        errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef SPECTRUMFILE_H
+#define SPECTRUMFILE_H
+
+#include <QString>
+#include <QStringList>
+
+#include "tablemodel.h"
+
+// Native binary container for spectra (*.dvs).
+//
+// The first column is the energy (Float64), the others are count channels (UInt32).
+//
+// Layout, little endian:
+//   FileHeader
+//   one ColumnHeader per column, each followed by its UTF-8 name padded to 8 bytes
+//   the raw column arrays, each starting on a 64 byte boundary
+// The checksum covers the column arrays in file order. Files are read by
+// memory mapping and copying the arrays, there is no parse step.
+class SpectrumFile
+{
+public:
+    enum ColumnType { Float64 = 1, UInt32 = 2 };
+
+    static QString suffix() { return "dvs"; };
+    static bool isSpectrumFile(const QString &fileName);
+
+    static bool read(const QString &fileName, QStringList &header, ColumnBlock &rows,
+                     QString &errorString);
+    static bool write(const QString &fileName, const QStringList &header,
+                      const ColumnBlock &rows, QString &errorString);
+
+    static quint64 checksum(const char *data, qint64 size, quint64 seed);
+};
+
+#endif // SPECTRUMFILE_H
@@ -0,0 +1,378 @@
+#include <QLocale>
+
+#include "tabledisplaymodel.h"
+
+TableDisplayModel::TableDisplayModel(QObject *parent) :
+    QAbstractTableModel(parent), source(0), windowStart(0), windowRows(0),
+    pendingChange(NoChange), pendingRows(0), pendingStart(0)
+{
+    textCache.setMaxCost(CachedRows);
+}
+
+void TableDisplayModel::setSourceModel(TableModel *model)
+{
+    beginResetModel();
+    if (source != NULL)
+        disconnect(source, 0, this, 0);
+    source = model;
+    windowStart = 0;
+    windowRows = source != NULL ? qMin(source->rowCount(), int(WindowRows)) : 0;
+    textCache.clear();
+
+    if (source != NULL)
+    {
+        connect(source, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+                this, SLOT(sourceDataChanged(QModelIndex,QModelIndex)));
+        connect(source, SIGNAL(headerDataChanged(Qt::Orientation,int,int)),
+                this, SLOT(sourceHeaderDataChanged(Qt::Orientation,int,int)));
+        connect(source, SIGNAL(rowsAboutToBeInserted(QModelIndex,int,int)),
+                this, SLOT(sourceRowsAboutToBeInserted(QModelIndex,int,int)));
+        connect(source, SIGNAL(rowsInserted(QModelIndex,int,int)),
+                this, SLOT(sourceRowsInserted(QModelIndex,int,int)));
+        connect(source, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)),
+                this, SLOT(sourceRowsAboutToBeRemoved(QModelIndex,int,int)));
+        connect(source, SIGNAL(rowsRemoved(QModelIndex,int,int)),
+                this, SLOT(sourceRowsRemoved(QModelIndex,int,int)));
+        connect(source, SIGNAL(rowsAboutToBeMoved(QModelIndex,int,int,QModelIndex,int)),
+                this, SLOT(sourceRowsAboutToBeMoved(QModelIndex,int,int,QModelIndex,int)));
+        connect(source, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)),
+                this, SLOT(sourceRowsMoved(QModelIndex,int,int,QModelIndex,int)));
+        connect(source, SIGNAL(layoutAboutToBeChanged()), this, SLOT(sourceLayoutAboutToBeChanged()));
+        connect(source, SIGNAL(layoutChanged()), this, SLOT(sourceLayoutChanged()));
+        connect(source, SIGNAL(modelAboutToBeReset()), this, SLOT(sourceModelAboutToBeReset()));
+        connect(source, SIGNAL(modelReset()), this, SLOT(sourceModelReset()));
+    }
+    endResetModel();
+    emit windowChanged();
+}
+
+int TableDisplayModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : windowRows;
+}
+
+int TableDisplayModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() || source == NULL ? 0 : source->columnCount();
+}
+
+QVariant TableDisplayModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || source == NULL || index.row() >= windowRows)
+        return QVariant();
+    if (role == Qt::DisplayRole)
+        return rowText(windowStart + index.row()).value(index.column());
+    return source->data(source->index(windowStart + index.row(), index.column()), role);
+}
+
+bool TableDisplayModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || source == NULL || index.row() >= windowRows)
+        return false;
+    return source->setData(source->index(windowStart + index.row(), index.column()), value, role);
+}
+
+QVariant TableDisplayModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (source == NULL)
+        return QVariant();
+    if (orientation == Qt::Vertical)
+        section += windowStart;
+    return source->headerData(section, orientation, role);
+}
+
+bool TableDisplayModel::setHeaderData(int section, Qt::Orientation orientation, const QVariant &value, int role)
+{
+    if (orientation == Qt::Vertical)
+        section += windowStart;
+    return source != NULL && source->setHeaderData(section, orientation, value, role);
+}
+
+Qt::ItemFlags TableDisplayModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid() || source == NULL || index.row() >= windowRows)
+        return Qt::NoItemFlags;
+    return source->flags(source->index(windowStart + index.row(), index.column()));
+}
+
+int TableDisplayModel::mapFromSource(int row) const
+{
+    return row >= windowStart && row < windowStart + windowRows ? row - windowStart : -1;
+}
+
+// The window starts at row, or as close to it as a full window allows.
+// Rows in both the old and the new window keep their persistent indexes,
+// and with them the selection and the current index of the view.
+void TableDisplayModel::setFirstRow(int row)
+{
+    if (source == NULL)
+        return;
+    const int start = qBound(0, row, qMax(0, source->rowCount() - windowRows));
+    if (start == windowStart)
+        return;
+
+    emit layoutAboutToBeChanged();
+    const QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    for (int i = 0; i < from.size(); ++i)
+    {
+        const int moved = from.at(i).row() + windowStart - start;
+        to.append(moved >= 0 && moved < windowRows ? index(moved, from.at(i).column()) : QModelIndex());
+    }
+    windowStart = start;
+    changePersistentIndexList(from, to);
+    emit layoutChanged();
+    emit windowChanged();
+}
+
+// The numbers as the delegate would show them, doubles with the fewest
+// digits that give the value back
+QStringList TableDisplayModel::rowText(int row) const
+{
+    if (QStringList *text = textCache.object(row))
+        return *text;
+
+    const ColumnBlock &columns = source->columns();
+    QLocale locale;
+    QStringList *text = new QStringList;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+    text->append(locale.toString(columns.column1At(row), 'g', QLocale::FloatingPointShortest));
+#else
+    text->append(locale.toString(columns.column1At(row), 'g', 15));
+#endif
+    for (int i = 0; i < columns.counts.size(); ++i)
+        text->append(locale.toString(columns.count(i, row)));
+
+    QStringList result = *text;
+    textCache.insert(row, text);
+    return result;
+}
+
+// The source changes below are passed on as far as they touch the rows
+// of the window; changes before it move the window along with its rows,
+// changes behind it are not seen by the view.
+
+void TableDisplayModel::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    const int first = qMax(topLeft.row(), windowStart);
+    const int last = qMin(bottomRight.row(), windowStart + windowRows - 1);
+    if (first > last)
+        return;
+    if (last - first >= int(CachedRows))
+        textCache.clear();
+    for (int row = first; row <= last && !textCache.isEmpty(); ++row)
+        textCache.remove(row);
+    emit dataChanged(index(first - windowStart, topLeft.column()),
+                     index(last - windowStart, bottomRight.column()));
+}
+
+void TableDisplayModel::sourceHeaderDataChanged(Qt::Orientation orientation, int first, int last)
+{
+    if (orientation == Qt::Vertical)
+    {
+        first = qMax(first - windowStart, 0);
+        last = qMin(last - windowStart, windowRows - 1);
+        if (first > last)
+            return;
+    }
+    emit headerDataChanged(orientation, first, last);
+}
+
+// Rows inserted in the window, or appended to a window that is not full,
+// are shown. The rows they push out of a full window are removed from it
+// first, while the source still has them where the view expects them.
+void TableDisplayModel::sourceRowsAboutToBeInserted(const QModelIndex & /* parent */, int first, int last)
+{
+    const int count = last - first + 1;
+    const int row = first - windowStart;
+    if (row > windowRows || row == int(WindowRows))
+        return;
+    textCache.clear();
+    if (row < 0)
+    {
+        pendingChange = ShiftChange;
+        pendingRows = count;
+        return;
+    }
+
+    pendingChange = InsertChange;
+    pendingRows = qMin(count, int(WindowRows) - row);
+    const int excess = windowRows + pendingRows - int(WindowRows);
+    if (excess > 0)
+    {
+        beginRemoveRows(QModelIndex(), windowRows - excess, windowRows - 1);
+        windowRows -= excess;
+        endRemoveRows();
+    }
+    beginInsertRows(QModelIndex(), row, row + pendingRows - 1);
+}
+
+void TableDisplayModel::sourceRowsInserted(const QModelIndex & /* parent */, int /* first */, int /* last */)
+{
+    const Change change = pendingChange;
+    pendingChange = NoChange;
+    if (change == InsertChange)
+    {
+        windowRows += pendingRows;
+        endInsertRows();
+    }
+    else if (change == ShiftChange)
+    {
+        windowStart += pendingRows;
+    }
+    emit windowChanged();
+}
+
+// the rows of the window that go are removed from the view, the window
+// is then filled up again from the source
+void TableDisplayModel::sourceRowsAboutToBeRemoved(const QModelIndex & /* parent */, int first, int last)
+{
+    const int end = windowStart + windowRows;
+    if (first >= end)
+        return;
+    textCache.clear();
+    if (last < windowStart)
+    {
+        pendingChange = ShiftChange;
+        pendingRows = -(last - first + 1);
+        return;
+    }
+
+    const int top = qMax(first, windowStart) - windowStart;
+    const int bottom = qMin(last, end - 1) - windowStart;
+    pendingChange = RemoveChange;
+    pendingRows = bottom - top + 1;
+    pendingStart = qMin(first, windowStart);
+    beginRemoveRows(QModelIndex(), top, bottom);
+}
+
+void TableDisplayModel::sourceRowsRemoved(const QModelIndex & /* parent */, int /* first */, int /* last */)
+{
+    const Change change = pendingChange;
+    pendingChange = NoChange;
+    if (change == RemoveChange)
+    {
+        windowRows -= pendingRows;
+        windowStart = pendingStart;
+        endRemoveRows();
+        fillWindow();
+    }
+    else if (change == ShiftChange)
+    {
+        windowStart += pendingRows;
+    }
+    emit windowChanged();
+}
+
+// rows behind the window take the place of removed ones, or rows before
+// it once it reaches the end of the source
+void TableDisplayModel::fillWindow()
+{
+    const int rows = source->rowCount();
+    const int tail = qMin(int(WindowRows), rows - windowStart) - windowRows;
+    if (tail > 0)
+    {
+        beginInsertRows(QModelIndex(), windowRows, windowRows + tail - 1);
+        windowRows += tail;
+        endInsertRows();
+    }
+    const int head = qMin(int(WindowRows), rows) - windowRows;
+    if (head > 0)
+    {
+        beginInsertRows(QModelIndex(), 0, head - 1);
+        windowStart -= head;
+        windowRows += head;
+        endInsertRows();
+    }
+}
+
+// a move within the window stays a move, one before or behind it does
+// not change its rows; any other changes which rows it has, which the view
+// gets as a new layout
+void TableDisplayModel::sourceRowsAboutToBeMoved(const QModelIndex & /* parent */, int first, int last,
+                                                 const QModelIndex & /* destination */, int row)
+{
+    const int end = windowStart + windowRows;
+    if ((first >= end && row >= end) || (last < windowStart && row <= windowStart))
+        return;
+    textCache.clear();
+    if (first >= windowStart && last < end && row >= windowStart && row <= end
+            && beginMoveRows(QModelIndex(), first - windowStart, last - windowStart,
+                             QModelIndex(), row - windowStart))
+    {
+        pendingChange = MoveChange;
+        return;
+    }
+    pendingChange = LayoutChange;
+    beginLayoutChange();
+}
+
+void TableDisplayModel::sourceRowsMoved(const QModelIndex & /* parent */, int /* first */, int /* last */,
+                                        const QModelIndex & /* destination */, int /* row */)
+{
+    const Change change = pendingChange;
+    pendingChange = NoChange;
+    if (change == MoveChange)
+        endMoveRows();
+    else if (change == LayoutChange)
+        endLayoutChange();
+}
+
+void TableDisplayModel::sourceLayoutAboutToBeChanged()
+{
+    beginLayoutChange();
+}
+
+void TableDisplayModel::sourceLayoutChanged()
+{
+    endLayoutChange();
+    emit windowChanged();
+}
+
+// The persistent indexes of the view are held as indexes of the source
+// while it changes, which moves them along with their rows. A row that
+// ends up outside the window is no longer shown.
+void TableDisplayModel::beginLayoutChange()
+{
+    emit layoutAboutToBeChanged();
+    layoutIndexes = persistentIndexList();
+    layoutSourceIndexes.clear();
+    for (int i = 0; i < layoutIndexes.size(); ++i)
+        layoutSourceIndexes.append(source->index(windowStart + layoutIndexes.at(i).row(),
+                                                 layoutIndexes.at(i).column()));
+}
+
+void TableDisplayModel::endLayoutChange()
+{
+    textCache.clear();
+    // the window stays full if the source has a different number of rows
+    const int rows = source->rowCount();
+    windowRows = qMin(int(WindowRows), rows);
+    windowStart = qBound(0, windowStart, rows - windowRows);
+
+    QModelIndexList to;
+    for (int i = 0; i < layoutSourceIndexes.size(); ++i)
+    {
+        const QPersistentModelIndex &moved = layoutSourceIndexes.at(i);
+        const int row = moved.isValid() ? mapFromSource(moved.row()) : -1;
+        to.append(row >= 0 ? index(row, moved.column()) : QModelIndex());
+    }
+    changePersistentIndexList(layoutIndexes, to);
+    layoutIndexes.clear();
+    layoutSourceIndexes.clear();
+    emit layoutChanged();
+}
+
+void TableDisplayModel::sourceModelAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void TableDisplayModel::sourceModelReset()
+{
+    windowStart = 0;
+    windowRows = qMin(source->rowCount(), int(WindowRows));
+    textCache.clear();
+    endResetModel();
+    emit windowChanged();
+}
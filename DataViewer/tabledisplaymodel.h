@@ -0,0 +1,87 @@
+#ifndef TABLEDISPLAYMODEL_H
+#define TABLEDISPLAYMODEL_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QStringList>
+
+#include "tablemodel.h"
+
+// The table view's side of a TableModel, which the graph uses directly.
+// A big table is shown through a window of at most WindowRows rows that
+// is moved over it as the view scrolls, see setFirstRow(), so the per-row
+// state of the view and its headers is the same for any size of table.
+// The display text of the rows in view is formatted once and kept in a
+// cache of a few screens, instead of a QVariant of each number being
+// formatted by the delegate on every repaint.
+class TableDisplayModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit TableDisplayModel(QObject *parent = 0);
+
+    void setSourceModel(TableModel *model);
+    TableModel *sourceModel() const { return source; };
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    bool setData(const QModelIndex &index, const QVariant &value, int role);
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+    bool setHeaderData(int section, Qt::Orientation orientation, const QVariant &value, int role);
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+
+    // the window starts at this row of the source
+    int firstRow() const { return windowStart; };
+    void setFirstRow(int row);
+    int mapToSource(int row) const { return windowStart + row; };
+    // -1 for a row outside the window
+    int mapFromSource(int row) const;
+
+    enum { WindowRows = 65536, CachedRows = 1024 };
+
+signals:
+    // the window moved, or the source has a different number of rows
+    void windowChanged();
+
+private slots:
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void sourceHeaderDataChanged(Qt::Orientation orientation, int first, int last);
+    void sourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first, int last);
+    void sourceRowsAboutToBeMoved(const QModelIndex &parent, int first, int last,
+                                  const QModelIndex &destination, int row);
+    void sourceRowsMoved(const QModelIndex &parent, int first, int last,
+                         const QModelIndex &destination, int row);
+    void sourceLayoutAboutToBeChanged();
+    void sourceLayoutChanged();
+    void sourceModelAboutToBeReset();
+    void sourceModelReset();
+
+private:
+    QStringList rowText(int row) const;
+    void fillWindow();
+    void beginLayoutChange();
+    void endLayoutChange();
+
+    TableModel *source;
+    // the view sees rows [windowStart, windowStart + windowRows) of the
+    // source, as many as WindowRows if the source has them
+    int windowStart;
+    int windowRows;
+    // what the source change in progress does to them
+    enum Change { NoChange, InsertChange, RemoveChange, MoveChange, LayoutChange, ShiftChange };
+    Change pendingChange;
+    int pendingRows;
+    int pendingStart;
+    // persistent indexes over a layout change, and where they are in the source
+    QModelIndexList layoutIndexes;
+    QList<QPersistentModelIndex> layoutSourceIndexes;
+
+    // display text by row of the source, which a move of the window keeps
+    mutable QCache<int, QStringList> textCache;
+};
+
+#endif // TABLEDISPLAYMODEL_H
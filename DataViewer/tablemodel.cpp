@@ -1,60 +1,462 @@
+#include <QFileInfo>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QThreadPool>
+#include <QTimer>
+#include <climits>
+#include <algorithm>
+
 #include "tablemodel.h"
+#include "csvreader.h"
+#include "csvwriter.h"
+#include "spectrumfile.h"
+#include "tracer.h"
+#include "workerthread.h"
 
 TableModel::TableModel(QObject *parent) :
-    QAbstractTableModel(parent), fileDataChanged(false)
+    QAbstractTableModel(parent), fileDataChanged(false), mSorted(true),
+    mCompactCounts(false), mPackingScheduled(false), mDuplicates(0), mColumn1Min(0), mColumn1Max(0)
 {
     mHeader.append("Energy (keV)");
     mHeader.append("Counts");
-    mData.append(RowData(0,0));
+    mData.column1.append(0);
+    mData.counts[0].append(0);
+    mCountsIndex.resize(1);
+    updateIndex(0, 0);
 }
 
 // read data from filestream
 bool TableModel::loadFile(QTextStream &in)
 {
-    mHeader.clear();
-    mData.clear();
-
     QString line;
     QStringList lineSplit;
 
     line=in.readLine();
     lineSplit= line.split(",",QString::SkipEmptyParts);
-    if(lineSplit.size()>2)
+    if(lineSplit.size()<2)
     {
-        return false;   // for now we only handle two-columned data
+        return false;   // we need energies and at least one count column
     }
-    mHeader.append(lineSplit.at(0));
-    mHeader.append(lineSplit.at(1));
+    QStringList header=lineSplit;
+    ColumnBlock rows(header.size()-1);
 
-    RowData rowData(0,0);
-    double column1, column2;
     while((line=in.readLine())!=NULL)
     {
         lineSplit= line.split(",",QString::SkipEmptyParts);
-        if(lineSplit.size()>2)
+        if(lineSplit.isEmpty())
+            continue;
+        if(lineSplit.size()!=header.size())
+        {
+            return false;
+        }
+        rows.column1.append(lineSplit.at(0).toDouble());
+        for(int i=1; i<lineSplit.size(); i++)
+        {
+            unsigned int count;
+            if(!CsvReader::toCount(lineSplit.at(i).toDouble(), count))
+                return false;
+            rows.counts[i-1].append(count);
+        }
+    }
+
+    setColumns(header, rows);
+    sortByColumn1(); // sort source data
+    return true;
+}
+
+// read data from a binary spectrum file, or a csv file through the memory
+// mapped reader; the current data is kept if the file cannot be read
+bool TableModel::loadFile(const QString &fileName)
+{
+    TRACE_SCOPE("TableModel::loadFile");
+    QStringList header;
+    ColumnBlock rows;
+    if (SpectrumFile::isSpectrumFile(fileName))
+    {
+        if (!SpectrumFile::read(fileName, header, rows, mErrorString))
+            return false;
+    }
+    else
+    {
+        CsvReader reader;
+        if (!reader.open(fileName) || !reader.readHeader(header))
+        {
+            mErrorString = reader.errorString();
+            return false;
+        }
+
+        rows = ColumnBlock(header.size() - 1);
+        rows.reserve(reader.estimatedRowCount());
+        if (reader.readRows(rows, INT_MAX) < 0)
         {
-            return false; // for now we only handle two-columned data
+            mErrorString = reader.errorString();
+            return false;
         }
-        column1=lineSplit.at(0).toDouble();
-        column2=lineSplit.at(1).toDouble();
-        rowData.column1=column1;
-        rowData.column2=column2;
-        mData.append(rowData);
     }
 
+    setColumns(header, rows);
     sortByColumn1(); // sort source data
+    fileDataChanged = false;
+    return true;
+}
+
+// take over the columns of rows, which is left empty
+void TableModel::setColumns(const QStringList &header, ColumnBlock &rows)
+{
+    beginResetModel();
+    mHeader = header;
+    mData.column1.swap(rows.column1);
+    mData.counts.swap(rows.counts);
+    mData.packed.clear();
+    mData.computedRows = 0;
+    if (mData.column1.isEmpty())
+    {
+        mData.column1.append(0);
+        for (int i = 0; i < mData.counts.size(); i++)
+            mData.counts[i].append(0);
+    }
+    mCountsIndex = QVector<MinMaxPyramid>(mData.counts.size());
+    mAxis = UniformAxis();
+    mDuplicates = 0;
+    updateIndex(0, mData.column1.size() - 1);
+    endResetModel();
+}
+
+void TableModel::beginLoading(const QStringList &header, int estimatedRows)
+{
+    beginResetModel();
+    mHeader = header;
+    mData = ColumnBlock(header.size() - 1);
+    mData.reserve(estimatedRows);
+    mCountsIndex = QVector<MinMaxPyramid>(mData.counts.size());
+    mAxis = UniformAxis();
+    mSorted = true;
+    mDuplicates = 0;
+    endResetModel();
+}
+
+void TableModel::appendRows(const ColumnBlock &rows)
+{
+    TRACE_SCOPE("TableModel::appendRows");
+    if (rows.isEmpty() || rows.counts.size() != mData.counts.size())
+        return;
+
+    // rows usually arrive in order, check so the views can rely on it
+    const double *column1 = rows.column1.constData();
+    if (mSorted && !mData.isEmpty() && column1[0] < mData.column1At(mData.size() - 1))
+        mSorted = false;
+    for (int i = 1; mSorted && i < rows.size(); i++)
+    {
+        if (column1[i] < column1[i-1])
+            mSorted = false;
+    }
+
+    const int first = mData.size();
+    beginInsertRows(QModelIndex(), first, first + rows.size() - 1);
+    // a computed column1 takes rows that stay on its line by counting them
+    if (mData.isColumn1Computed()
+            && mData.line.continuesExactly(ColumnSpan<double>(column1, rows.size()), first))
+    {
+        mData.computedRows += rows.size();
+    }
+    else
+    {
+        // into the columns reserved by beginLoading(), even the first block
+        restoreColumn1();
+        mData.column1 += rows.column1;
+    }
+    for (int i = 0; i < mData.counts.size(); i++)
+    {
+        if (mData.isPacked(i))
+            mData.packed[i].append(rows.counts.at(i).constData(), rows.size());
+        else
+            mData.counts[i] += rows.counts.at(i);
+    }
+    // a growing acquisition keeps its calibration; a computed column1
+    // goes with it, as lookups on it need the line
+    if (!mAxis.extends(column1(), first))
+    {
+        restoreColumn1();
+        mAxis = UniformAxis();
+    }
+    mergeColumn1Range(first, mData.size() - 1);
+    updateIndex(first, mData.size() - 1);
+    endInsertRows();
+}
+
+void TableModel::endLoading()
+{
+    if (mData.isEmpty())
+    {
+        beginInsertRows(QModelIndex(), 0, 0);
+        mData.column1.append(0);
+        for (int i = 0; i < mData.counts.size(); i++)
+            mData.counts[i].append(0);
+        updateIndex(0, 0);
+        endInsertRows();
+    }
+    sortByColumn1(); // sort source data
+    fileDataChanged = false;
+}
+
+// more separate blocks of rows than this are inserted or removed in one
+// pass and a model reset, rather than a pass and a signal pair per block
+static const int maxRowBlocks = 32;
+
+// orders row numbers by their column1 value
+class Column1Less{
+public:
+    explicit Column1Less(const double *column1) : column1(column1) {};
+    bool operator ()(int a, int b) const{
+        return column1[a]<column1[b];
+    };
+private:
+    const double *column1;
+};
+
+// the column with newValues[inserted[k]] put in before row positions[k]
+template<typename T>
+static void mergeColumn(QVector<T> &column, const QVector<T> &newValues,
+                        const QVector<int> &inserted, const QVector<int> &positions)
+{
+    QVector<T> merged(column.size()+inserted.size());
+    const T *values=column.constData();
+    T *out=merged.data();
+    int next=0;
+    for(int k=0; k<inserted.size(); k++)
+    {
+        out=std::copy(values+next, values+positions.at(k), out);
+        next=positions.at(k);
+        *out++=newValues.at(inserted.at(k));
+    }
+    std::copy(values+next, values+column.size(), out);
+    column.swap(merged);
+}
+
+// the column without the rows [first, last) of an ascending row list
+template<typename T>
+static void removeSorted(QVector<T> &column, const int *first, const int *last)
+{
+    T *values=column.data();
+    int out=*first;
+    for(const int *row=first; row!=last; row++)
+    {
+        const int next= row+1!=last ? row[1] : column.size();
+        for(int i=*row+1; i<next; i++)
+            values[out++]=values[i];
+    }
+    column.resize(out);
+}
+
+// Rows that continue the sorted table are appended in one batch, which is
+// the usual case for a growing acquisition file. Anything else is sorted
+// and merged in one pass: a row with an existing column1 value updates its
+// counts, the others are inserted a block per gap between the table rows.
+void TableModel::mergeRows(const ColumnBlock &rows)
+{
+    TRACE_SCOPE("TableModel::mergeRows");
+    if (rows.isEmpty() || rows.counts.size() != mData.counts.size())
+        return;
+
+    const double *column1 = rows.column1.constData();
+    bool appendable = !mSorted || mData.isEmpty() || column1[0] > mData.column1At(mData.size() - 1);
+    for (int i = 1; appendable && i < rows.size(); i++)
+    {
+        if (column1[i] <= column1[i-1])
+            appendable = false;
+    }
+
+    if (appendable)
+    {
+        appendRows(rows);
+        return;
+    }
+
+    unpackCounts();
+    QVector<int> order(rows.size());
+    for (int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), Column1Less(column1));
+
+    // the table position and the row of rows for every new row; a
+    // computed column1 is only stored once rows go in between
+    const ColumnSpan<double> values = this->column1();
+    const int size = mData.size();
+    QVector<int> positions, inserted;
+    int firstUpdated = size, lastUpdated = -1;
+    int position = 0;
+    for (int k = 0; k < order.size(); k++)
+    {
+        const int row = order.at(k);
+        // of equal values the last one counts
+        if (k + 1 < order.size() && column1[order.at(k + 1)] == column1[row])
+            continue;
+        position = lowerBound(column1[row]);
+        if (position < size && values[position] == column1[row])
+        {
+            for (int i = 0; i < mData.counts.size(); i++)
+                mData.counts[i][position] = rows.counts.at(i).at(row);
+            firstUpdated = qMin(firstUpdated, position);
+            lastUpdated = position;
+        }
+        else
+        {
+            positions.append(position);
+            inserted.append(row);
+        }
+    }
+
+    if (lastUpdated >= 0)
+    {
+        updateIndex(firstUpdated, lastUpdated);
+        emit dataChanged(index(firstUpdated, 1), index(lastUpdated, mData.counts.size()));
+    }
+    if (inserted.isEmpty())
+        return;
+
+    restoreColumn1();
+    int blocks = 1;
+    for (int k = 1; k < positions.size(); k++)
+    {
+        if (positions.at(k) != positions.at(k - 1))
+            blocks++;
+    }
+    mAxis = UniformAxis();
+    if (blocks <= maxRowBlocks)
+    {
+        // from the bottom, so the positions above stay where they are
+        for (int end = inserted.size(); end > 0; )
+        {
+            int begin = end - 1;
+            while (begin > 0 && positions.at(begin - 1) == positions.at(begin))
+                begin--;
+            insertBlock(positions.at(begin), rows, inserted.constData() + begin, end - begin);
+            end = begin;
+        }
+        return;
+    }
+
+    // a new layout rather than a reset, which keeps the views' state
+    emit layoutAboutToBeChanged();
+    mergeColumn(mData.column1, rows.column1, inserted, positions);
+    for (int i = 0; i < mData.counts.size(); i++)
+        mergeColumn(mData.counts[i], rows.counts.at(i), inserted, positions);
+
+    // a row moves down by the new rows inserted at or above it
+    const QModelIndexList from = persistentIndexList();
+    if (!from.isEmpty())
+    {
+        QModelIndexList to;
+        for (int i = 0; i < from.size(); i++)
+        {
+            const int row = from.at(i).row();
+            const int above = std::upper_bound(positions.constBegin(), positions.constEnd(), row)
+                    - positions.constBegin();
+            to.append(index(row + above, from.at(i).column()));
+        }
+        changePersistentIndexList(from, to);
+    }
+    mergeColumn1Range(0, mData.size() - 1);
+    updateIndex(0, mData.size() - 1);
+    emit layoutChanged();
+}
+
+// rows[order[0]] .. rows[order[count-1]] inserted before row position
+void TableModel::insertBlock(int position, const ColumnBlock &rows, const int *order, int count)
+{
+    beginInsertRows(QModelIndex(), position, position + count - 1);
+    mData.column1.insert(position, count, 0);
+    double *column1 = mData.column1.data() + position;
+    for (int k = 0; k < count; k++)
+        column1[k] = rows.column1.at(order[k]);
+    for (int i = 0; i < mData.counts.size(); i++)
+    {
+        mData.counts[i].insert(position, count, 0);
+        unsigned int *counts = mData.counts[i].data() + position;
+        for (int k = 0; k < count; k++)
+            counts[k] = rows.counts.at(i).at(order[k]);
+    }
+    mergeColumn1Range(position, position + count - 1);
+    updateIndex(position, mData.size() - 1);
+    endInsertRows();
+}
+
+// Rows as csv text, e.g. from the clipboard, merged into the table as a
+// growing file is. Tabs separate the columns as well, as spreadsheets
+// copy them, and a header line is skipped.
+bool TableModel::pasteRows(const QString &text)
+{
+    TRACE_SCOPE("TableModel::pasteRows");
+    QByteArray data = text.trimmed().toUtf8();
+    data.replace('\t', ',');
+    CsvReader reader;
+    reader.setBuffer(data);
+
+    // a header starts with a name rather than a number
+    int fieldEnd = 0;
+    while (fieldEnd < data.size() && data.at(fieldEnd) != ',' && data.at(fieldEnd) != '\n'
+           && data.at(fieldEnd) != '\r')
+        fieldEnd++;
+    double value;
+    QStringList header;
+    if (!CsvReader::parseDouble(data.constData(), data.constData() + fieldEnd, value))
+        reader.readHeader(header);
+    reader.setColumnCount(columnCount());
+
+    ColumnBlock rows(mData.counts.size());
+    if (reader.readRows(rows, INT_MAX) < 0)
+    {
+        mErrorString = reader.errorString();
+        return false;
+    }
+    if (rows.isEmpty())
+    {
+        mErrorString = tr("No rows to paste");
+        return false;
+    }
+    mergeRows(rows);
+    fileDataChanged = true;
     return true;
 }
 
 // write data to filestream
 void TableModel::saveFile(QTextStream &out)
 {
-    out<<mHeader.at(0)<<","<<mHeader.at(1)<<endl;
-    for(int i=0; i<mData.size();i++)
+    TRACE_SCOPE("TableModel::saveFile");
+    // same round trip formatting as the csv files, a block of rows at a time
+    const int blockRows = 65536;
+    QByteArray block;
+    out<<mHeader.join(",")<<"\n";
+    for(int first=0; first<mData.size(); first+=blockRows)
     {
-        out<<mData.at(i).column1<<","<<mData.at(i).column2<<endl;
+        block.clear();
+        CsvWriter::formatRows(mData, first, qMin(first+blockRows, mData.size()), block);
+        out<<QString::fromLatin1(block);
     }
+    out.flush();
+    fileDataChanged = false;
+}
+
+// write data as csv, or as a binary spectrum file for its suffix; the
+// old file is only replaced once the new one is complete
+bool TableModel::saveFile(const QString &fileName)
+{
+    if (QFileInfo(fileName).suffix().compare(SpectrumFile::suffix(), Qt::CaseInsensitive) == 0)
+        return saveBinaryFile(fileName);
+
+    if (!CsvWriter::write(fileName, mHeader, mData, mErrorString))
+        return false;
+    fileDataChanged = false;
+    return true;
+}
+
+// write data as a binary spectrum file
+bool TableModel::saveBinaryFile(const QString &fileName)
+{
+    if (!SpectrumFile::write(fileName, mHeader, mData, mErrorString))
+        return false;
     fileDataChanged = false;
+    return true;
 }
 
 int TableModel::columnCount(const QModelIndex &parent) const
@@ -70,12 +472,7 @@ int TableModel::rowCount(const QModelIndex &parent) const
 QVariant TableModel::data(const QModelIndex &index, int role ) const
 {
     if(index.isValid() && (role == Qt::EditRole|| role == Qt::DisplayRole))
-    {
-         if(index.column()==0)
-            return mData.at(index.row()).column1;
-         else if(index.column()==1)
-            return mData.at(index.row()).column2;
-    }
+        return getData(index.row(), index.column());
     return QVariant();
 }
 
@@ -83,20 +480,46 @@ bool TableModel::setData(const QModelIndex &index, const QVariant &value, int ro
 {
     if(index.isValid() && role==Qt::EditRole)
     {
+         bool ok=false;
+         const double number=value.toDouble(&ok);
+         if(!ok || number!=number)
+             return false;
          if(index.column()==0)
          {
-            for(int i=0; i<mData.size(); i++)
+            // the same value again leaves the document unmodified
+            if(number==mData.column1At(index.row()))
+                return true;
+            restoreColumn1();
+            if(mSorted)
             {
-                // we should not have the same energy value twice
-                if(value.toDouble()==mData.at(i).column1 && (i!=index.column()))
+                if(!setColumn1Sorted(index.row(), number))
                     return false;
             }
-            mData[index.row()].column1=value.toDouble();
-            sortByColumn1(); //will emit layoutChanged();
+            else
+            {
+                for(int i=0; i<mData.size(); i++)
+                {
+                    // we should not have the same energy value twice
+                    if(number==mData.column1.at(i) && (i!=index.row()))
+                        return false;
+                }
+                mData.column1[index.row()]=number;
+                if(!sortByColumn1()) //will emit layoutChanged() if rows move
+                    emit dataChanged(index, index);
+            }
          }
-         else if(index.column()==1)
+         else if(index.column()<=mData.counts.size())
          {
-            mData[index.row()].column2=value.toDouble();
+            // as for counts read from a file
+            unsigned int newCount;
+            if(!CsvReader::toCount(number, newCount))
+                return false;
+            const int series=index.column()-1;
+            if(newCount==count(series, index.row()))
+                return true;
+            unpackCounts(series);
+            mData.counts[series][index.row()]=newCount;
+            updateIndex(series, index.row(), index.row());
             emit dataChanged(index, index);
          }
          fileDataChanged = true;
@@ -128,54 +551,599 @@ bool TableModel::setHeaderData(int section, Qt::Orientation orientation, const Q
 
 Qt::ItemFlags TableModel::flags(const QModelIndex &index) const
 {
-    if(index.isValid() && index.column()<2 && index.row()<mData.size())
+    if(index.isValid() && index.column()<columnCount() && index.row()<mData.size())
     {
         return Qt::ItemIsEditable|Qt::ItemIsEnabled;
     }
     return Qt::NoItemFlags;
 }
 
-bool TableModel::  insertRows(int row, int count, const QModelIndex &parent)
+// move [first, middle) behind [middle, last) in every column
+static void rotateRows(ColumnBlock &data, int first, int middle, int last)
 {
-    if (row<mData.size() && count>0)
+    double *column1=data.column1.data();
+    std::rotate(column1+first, column1+middle, column1+last);
+    for(int i=0; i<data.counts.size(); i++)
     {
-        QAbstractItemModel::beginInsertRows(parent,row,row+count-1);
-        while(count>0)
-        {
-            count--;
-            mData.insert(row,RowData(0,0));
-        }
-        emit layoutChanged();
-        QAbstractItemModel::endInsertRows();
-        return true;
+        unsigned int *counts=data.counts[i].data();
+        std::rotate(counts+first, counts+middle, counts+last);
     }
-    return false;
+}
+
+// change column1 of one row and move the row to keep the order; the
+// position and the duplicate check are a binary search, only the rows in
+// between are shifted
+bool TableModel::setColumn1Sorted(int row, double value)
+{
+    TRACE_SCOPE("TableModel::setColumn1Sorted");
+    const double *values=mData.column1.constData();
+    const int size=mData.size();
+    const int position=std::lower_bound(values, values+size, value)-values;
+
+    // we should not have the same energy value twice; the row's own value
+    // is no change at all, which setData() does not get here with
+    if(position<size && values[position]==value)
+        return false;
+
+    const int target = position>row ? position-1 : position;
+    mAxis=UniformAxis();
+    if(target!=row)
+    {
+        unpackCounts();
+        if(!beginMoveRows(QModelIndex(), row, row, QModelIndex(), target>row ? target+1 : target))
+            return false;
+
+        if(target>row)
+            rotateRows(mData, row, row+1, target+1);
+        else
+            rotateRows(mData, target, row, row+1);
+        mData.column1[target]=value;
+        mColumn1Min=mData.column1.first();
+        mColumn1Max=mData.column1.last();
+        updateIndex(qMin(row,target), qMax(row,target));
+        endMoveRows();
+    }
+    else
+    {
+        mData.column1[row]=value;
+        mColumn1Min=mData.column1.first();
+        mColumn1Max=mData.column1.last();
+    }
+
+    QModelIndex changed=index(target, 0);
+    emit dataChanged(changed, changed);
+    return true;
+}
+
+// new rows get evenly spaced column1 values between their neighbours,
+// so the table stays sorted and free of duplicates
+bool TableModel::insertRows(int row, int count, const QModelIndex &parent)
+{
+    const ColumnSpan<double> column1=this->column1();
+    const int size=column1.size();
+    if (row<0 || row>size || count<=0)
+        return false;
+
+    double start=0, step=1;
+    if (row>0 && row<size)
+    {
+        step=(column1[row]-column1[row-1])/(count+1);
+        start=column1[row-1]+step;
+    }
+    else if (row==0 && size>0)
+    {
+        if (size>1)
+            step=column1[1]-column1[0];
+        start=column1[0]-count*step;
+    }
+    else if (row==size && size>0)
+    {
+        if (size>1)
+            step=column1[size-1]-column1[size-2];
+        start=column1[size-1]+step;
+    }
+
+    QVector<double> values(count);
+    for (int i=0; i<count; i++)
+    {
+        values[i]=start+i*step;
+        // no room left between the neighbours
+        if ((i>0 && values.at(i)<=values.at(i-1))
+                || (row>0 && values.at(i)<=column1[row-1])
+                || (row<size && values.at(i)>=column1[row]))
+            return false;
+    }
+
+    restoreColumn1();
+    unpackCounts();
+    QAbstractItemModel::beginInsertRows(parent,row,row+count-1);
+    mData.column1.insert(row,count,0);
+    for(int i=0; i<mData.counts.size(); i++)
+        mData.counts[i].insert(row,count,0);
+    std::copy(values.constBegin(), values.constEnd(), mData.column1.begin()+row);
+    mAxis=UniformAxis();
+    mergeColumn1Range(row, row+count-1);
+    updateIndex(row, mData.size()-1);
+    QAbstractItemModel::endInsertRows();
+    fileDataChanged = true;
+    return true;
 }
 
 
 bool TableModel::removeRows(int row, int count, const QModelIndex &parent)
 {
-    if(row<mData.size() && count>0)
+    const int size=mData.size();
+    if(row<0 || row>=size || count<=0)
+        return false;
+    count=qMin(count, size-row);
+    unpackCounts();
+
+    if(count==size)
+    {
+        // the table keeps one row, which is cleared instead of removed
+        if(size>1)
+            QAbstractItemModel::beginRemoveRows(parent,1,size-1);
+        mData.computedRows=0;
+        mData.column1.resize(1);
+        mData.column1[0]=0;
+        for(int i=0; i<mData.counts.size(); i++)
+        {
+            mData.counts[i].resize(1);
+            mData.counts[i][0]=0;
+        }
+        mColumn1Min=mColumn1Max=0;
+        mAxis=UniformAxis();
+        updateIndex(0, 0);
+        if(size>1)
+            QAbstractItemModel::endRemoveRows();
+        emit dataChanged(index(0,0), index(0,columnCount()-1));
+    }
+    else
     {
         QAbstractItemModel::beginRemoveRows(parent,row,row+count-1);
-        while(count>0)
+        // the rows left before a removed tail are still on the line
+        if(row+count==size && mData.isColumn1Computed())
         {
-            count--;
-            if(mData.size()>1)
-                mData.removeAt(row);
-            else
-                mData[0]=RowData(0,0);
+            mData.computedRows-=count;
         }
-        emit layoutChanged();
+        else
+        {
+            restoreColumn1();
+            mData.column1.remove(row,count);
+        }
+        for(int i=0; i<mData.counts.size(); i++)
+            mData.counts[i].remove(row,count);
+        if(row+count<size)
+            mAxis=UniformAxis();
+        if(!mSorted)
+            mergeColumn1Range(0, mData.size()-1);
+        updateIndex(row, mData.size()-1);
         QAbstractItemModel::endRemoveRows();
+    }
+    fileDataChanged = true;
+    return true;
+}
+
+// Rows of a multi-row selection, in any order. One block of rows is an
+// ordinary removal, a few are removed from the bottom up, and more than
+// that are compacted in a single pass.
+bool TableModel::removeRowSet(const QVector<int> &rows)
+{
+    QVector<int> sorted=rows;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    const int *first=std::lower_bound(sorted.constBegin(), sorted.constEnd(), 0);
+    const int *last=std::lower_bound(first, sorted.constEnd(), mData.size());
+    if(first==last)
+        return false;
+
+    int blocks=1;
+    for(const int *row=first+1; row!=last; row++)
+    {
+        if(*row!=row[-1]+1)
+            blocks++;
+    }
+    if(blocks<=maxRowBlocks)
+    {
+        // from the bottom, so the rows above keep their numbers
+        for(const int *end=last; end!=first; )
+        {
+            const int *begin=end-1;
+            while(begin!=first && begin[-1]==*begin-1)
+                begin--;
+            removeRows(*begin, int(end-begin), QModelIndex());
+            end=begin;
+        }
         return true;
     }
-    return false;
+
+    // the blocks leave at least one row, as all rows would be one block
+    restoreColumn1();
+    unpackCounts();
+    emit layoutAboutToBeChanged();
+    removeSorted(mData.column1, first, last);
+    for(int i=0; i<mData.counts.size(); i++)
+        removeSorted(mData.counts[i], first, last);
+
+    // removed rows lose their indexes, the others move up past the removed
+    // rows above them
+    const QModelIndexList from=persistentIndexList();
+    if(!from.isEmpty())
+    {
+        QModelIndexList to;
+        for(int i=0; i<from.size(); i++)
+        {
+            const int row=from.at(i).row();
+            const int *removed=std::lower_bound(first, last, row);
+            if(removed!=last && *removed==row)
+                to.append(QModelIndex());
+            else
+                to.append(index(row-int(removed-first), from.at(i).column()));
+        }
+        changePersistentIndexList(from, to);
+    }
+    mAxis=UniformAxis();
+    if(!mSorted)
+        mergeColumn1Range(0, mData.size()-1);
+    updateIndex(0, mData.size()-1);
+    emit layoutChanged();
+    fileDataChanged = true;
+    return true;
+}
+
+// more ascending runs than this are too short to merge as they are, the
+// rows are sorted in chunks instead
+static const int maxMergedRuns = 256;
+// smaller tables are ordered on the calling thread
+static const int parallelSortRows = 65536;
+
+// a column1 value and its row; equal values keep their row order, so
+// chunks and runs merge into the same order a stable sort gives
+struct SortKey
+{
+    double value;
+    int row;
+
+    bool operator <(const SortKey &other) const
+    {
+        return value < other.value || (value == other.value && row < other.row);
+    };
+};
+
+// sort keys [first, last) on the pool
+class SortTask : public QRunnable
+{
+public:
+    SortTask(SortKey *first, SortKey *last) : first(first), last(last) {};
+    void run() { std::sort(first, last); };
+
+private:
+    SortKey *first, *last;
+};
+
+// merge the runs [first, middle) and [middle, last) into out
+class MergeTask : public QRunnable
+{
+public:
+    MergeTask(const SortKey *first, const SortKey *middle, const SortKey *last, SortKey *out) :
+        first(first), middle(middle), last(last), out(out) {};
+    void run() { std::merge(first, middle, middle, last, out); };
+
+private:
+    const SortKey *first, *middle, *last;
+    SortKey *out;
+};
+
+// on the pool if there is one, right away otherwise
+static void startTask(QThreadPool *pool, QRunnable *task)
+{
+    if(pool)
+    {
+        pool->start(task);
+        return;
+    }
+    task->run();
+    delete task;
+}
+
+// merge the sorted runs between bounds pairwise, round after round, until
+// keys is one run; the odd run of a round is copied over as it is
+static void mergeRuns(QVector<SortKey> &keys, QVector<int> &bounds, QThreadPool *pool)
+{
+    QVector<SortKey> buffer(keys.size());
+    while(bounds.size()>2)
+    {
+        const SortKey *in=keys.constData();
+        QVector<int> merged;
+        merged.append(0);
+        for(int i=0; i+1<bounds.size(); i+=2)
+        {
+            const int middle=bounds.at(i+1);
+            const int last= i+2<bounds.size() ? bounds.at(i+2) : middle;
+            startTask(pool, new MergeTask(in+bounds.at(i), in+middle, in+last, buffer.data()+bounds.at(i)));
+            merged.append(last);
+        }
+        if(pool)
+            pool->waitForDone();
+        keys.swap(buffer);
+        bounds.swap(merged);
+    }
+}
+
+// gather the values of column in the order of permutation
+template<typename T>
+static void permute(QVector<T> &column, const QVector<int> &permutation)
+{
+    QVector<T> sorted(column.size());
+    const T *values=column.constData();
+    T *out=sorted.data();
+    for(int i=0; i<permutation.size(); i++)
+        out[i]=values[permutation.at(i)];
+    column.swap(sorted);
+}
+
+// Files are almost always in order already, so one pass over column1
+// first finds the ascending runs and counts the equal neighbours. A single
+// run is left as it is. A few runs are merged; more than that are sorted
+// in chunks, on a thread pool for big tables unless this is a worker
+// thread already, and the chunks merged. The row order is applied to
+// every column at the end. Returns true if any rows moved.
+bool TableModel::sortByColumn1()
+{
+    TRACE_SCOPE("TableModel::sortByColumn1");
+    // a computed column1 is an ascending line
+    if(mData.isColumn1Computed())
+        return false;
+    const int size=mData.size();
+    const double *values=mData.column1.constData();
+    QVector<int> bounds;
+    bounds.append(0);
+    int duplicates=0;
+    for(int i=1; i<size; i++)
+    {
+        if(values[i]<values[i-1])
+            bounds.append(i);
+        else if(values[i]==values[i-1])
+            duplicates++;
+    }
+    bounds.append(size);
+
+    const bool moved=bounds.size()>2;
+    if(moved)
+    {
+        emit layoutAboutToBeChanged();
+        unpackCounts();
+        QVector<int> permutation(size);
+        {
+            QVector<SortKey> keys(size);
+            for(int i=0; i<size; i++)
+            {
+                keys[i].value=values[i];
+                keys[i].row=i;
+            }
+
+            // a worker thread, e.g. a batch job, sorts on its own
+            QScopedPointer<QThreadPool> pool;
+            if(size>=parallelSortRows && !isWorkerThread())
+                pool.reset(new QThreadPool);
+            if(bounds.size()-1>maxMergedRuns)
+            {
+                const int chunks= pool ? qMax(1, pool->maxThreadCount()) : 1;
+                bounds.clear();
+                for(int i=0; i<=chunks; i++)
+                    bounds.append(int(qint64(size)*i/chunks));
+                for(int i=0; i<chunks; i++)
+                    startTask(pool.data(), new SortTask(keys.data()+bounds.at(i), keys.data()+bounds.at(i+1)));
+                if(pool)
+                    pool->waitForDone();
+            }
+            mergeRuns(keys, bounds, pool.data());
+
+            // equal values are neighbours now, which the runs alone missed
+            duplicates=0;
+            for(int i=0; i<size; i++)
+            {
+                permutation[i]=keys.at(i).row;
+                if(i>0 && keys.at(i).value==keys.at(i-1).value)
+                    duplicates++;
+            }
+        }
+
+        permute(mData.column1, permutation);
+        for(int i=0; i<mData.counts.size(); i++)
+            permute(mData.counts[i], permutation);
+
+        // the views' current index and selection follow their rows
+        const QModelIndexList from=persistentIndexList();
+        if(!from.isEmpty())
+        {
+            QVector<int> newRow(size);
+            for(int i=0; i<size; i++)
+                newRow[permutation.at(i)]=i;
+            QModelIndexList to;
+            for(int i=0; i<from.size(); i++)
+                to.append(index(newRow.at(from.at(i).row()), from.at(i).column()));
+            changePersistentIndexList(from, to);
+        }
+    }
+
+    mSorted = true;
+    mDuplicates = duplicates;
+    mAxis = UniformAxis::detect(column1());
+    if(!mData.isEmpty())
+    {
+        mColumn1Min = mData.column1.first();
+        mColumn1Max = mData.column1.last();
+    }
+    if(moved)
+        updateIndex(0, mData.size()-1);
+    dropColumn1();
+    packCounts();
+    if(moved)
+        emit layoutChanged();
+    return moved;
+}
+
+TableSnapshot TableModel::snapshot() const
+{
+    TableSnapshot snapshot;
+    snapshot.headers=mHeader;
+    snapshot.data=mData;
+    snapshot.index=mCountsIndex;
+    snapshot.axis=mAxis;
+    snapshot.sorted=mSorted;
+    return snapshot;
+}
+
+void TableModel::column1Range(double &min, double &max) const
+{
+    if(mData.isEmpty())
+    {
+        min = max = 0;
+    }
+    else if(mSorted)
+    {
+        min = mData.column1At(0);
+        max = mData.column1At(mData.size()-1);
+    }
+    else
+    {
+        min = mColumn1Min;
+        max = mColumn1Max;
+    }
+}
+
+// widen the tracked column1 range by rows [first, last]
+void TableModel::mergeColumn1Range(int first, int last)
+{
+    if(first==0 && last==mData.size()-1 && last>=0)
+        mColumn1Min = mColumn1Max = mData.column1At(0);   // all rows are new
+    for(int i=first; i<=last; i++)
+    {
+        mColumn1Min = qMin(mColumn1Min, mData.column1At(i));
+        mColumn1Max = qMax(mColumn1Max, mData.column1At(i));
+    }
+}
+
+// keep the min/max indexes in step with the counts after rows [first, last] changed
+void TableModel::updateIndex(int first, int last)
+{
+    for(int i=0; i<mData.counts.size(); i++)
+        updateIndex(i, first, last);
 }
 
-// sort by column1 data
-void TableModel::sortByColumn1()
+void TableModel::updateIndex(int series, int first, int last)
 {
-    std::sort(mData.begin(),mData.end());
-    emit layoutChanged();;
+    if(mData.isPacked(series))
+    {
+        mCountsIndex[series].update(mData.packed.at(series), first, last);
+        return;
+    }
+    const QVector<unsigned int> &counts=mData.counts.at(series);
+    mCountsIndex[series].update(counts.constData(), counts.size(), first, last);
+}
+
+void TableModel::countRange(int series, int first, int last, unsigned int &min, unsigned int &max) const
+{
+    if(mData.isPacked(series))
+        mCountsIndex.at(series).query(mData.packed.at(series), first, last, min, max);
+    else
+        mCountsIndex.at(series).query(mData.counts.at(series).constData(), first, last, min, max);
+}
+
+void TableSnapshot::countRange(int series, int first, int last, unsigned int &min, unsigned int &max) const
+{
+    if(data.isPacked(series))
+        index.at(series).query(data.packed.at(series), first, last, min, max);
+    else
+        index.at(series).query(data.counts.at(series).constData(), first, last, min, max);
+}
+
+void TableModel::setCompactCounts(bool on)
+{
+    mCompactCounts=on;
+    if(on)
+        packCounts();
+    else
+        unpackCounts();
+}
+
+// A column is only kept packed when that saves memory. The values do
+// not change, so neither the views nor the index hear about it.
+void TableModel::packCounts()
+{
+    TRACE_SCOPE("TableModel::packCounts");
+    mPackingScheduled=false;
+    if(!mCompactCounts)
+        return;
+    mData.packed.resize(mData.counts.size());
+    for(int i=0; i<mData.counts.size(); i++)
+    {
+        const QVector<unsigned int> &counts=mData.counts.at(i);
+        if(mData.isPacked(i) || counts.isEmpty())
+            continue;
+        CompressedCounts packed(counts.constData(), counts.size());
+        if(packed.memorySize()<qint64(counts.size())*qint64(sizeof(unsigned int)))
+        {
+            mData.packed[i]=packed;
+            mData.counts[i]=QVector<unsigned int>();
+        }
+    }
+}
+
+void TableModel::unpackCounts()
+{
+    for(int i=0; i<mData.counts.size(); i++)
+        unpackCounts(i);
+}
+
+void TableModel::unpackCounts(int series)
+{
+    if(!mData.isPacked(series))
+        return;
+    mData.counts[series]=mData.packed.at(series).toVector();
+    mData.packed[series]=CompressedCounts();
+    if(mCompactCounts && !mPackingScheduled)
+    {
+        mPackingScheduled=true;
+        QTimer::singleShot(0, this, SLOT(packCounts()));
+    }
+}
+
+// A column1 that an exact calibration line gives bit for bit is computed
+// from it instead of being stored, which halves the memory of a spectrum
+// with one count column. Neither the views nor the index hear about it.
+void TableModel::dropColumn1()
+{
+    if(!mAxis.isExact() || mData.isColumn1Computed() || mData.isEmpty())
+        return;
+    mData.line=mAxis;
+    mData.computedRows=mData.size();
+    mData.column1=QVector<double>();
+}
+
+// stored again for a change that takes column1 off its line
+void TableModel::restoreColumn1()
+{
+    if(!mData.isColumn1Computed())
+        return;
+    const int size=mData.size();
+    QVector<double> column1(size);
+    for(int i=0; i<size; i++)
+        column1[i]=mData.line.value(i);
+    mData.column1.swap(column1);
+    mData.computedRows=0;
+    mData.line=UniformAxis();
+}
+
+qint64 TableModel::countsMemorySize() const
+{
+    qint64 size=0;
+    for(int i=0; i<mData.counts.size(); i++)
+    {
+        size+=qint64(mData.counts.at(i).size())*qint64(sizeof(unsigned int));
+        if(mData.isPacked(i))
+            size+=mData.packed.at(i).memorySize();
+    }
+    return size;
 }
@@ -4,21 +4,109 @@
 #include <QAbstractTableModel>
 #include <QTextStream>
 #include <QStringList>
-
-// class to represent one Row Data
-class RowData{
+#include <QVector>
+
+#include "columnspan.h"
+#include "compressedcounts.h"
+#include "minmaxpyramid.h"
+#include "uniformaxis.h"
+
+// a block of rows in column layout, as produced by the csv reader:
+// column1 is the energy, followed by one or more count channels. A count
+// column may be held packed instead, see TableModel::setCompactCounts();
+// read the counts through count() and countRows() where that can happen.
+// column1 may be computed from an exact calibration line instead, see
+// TableModel::sortByColumn1(); read it through column1At(), column1Span()
+// and column1Rows() where that can happen.
+class ColumnBlock{
 public:
-    RowData(double column1, unsigned int column2){
-        this->column1=column1; this->column2=column2;
+    explicit ColumnBlock(int countColumns=1) : counts(countColumns), computedRows(0) {};
+
+    void reserve(int size){
+        column1.reserve(size);
+        for(int i=0; i<counts.size(); i++)
+            counts[i].reserve(size);
+    };
+    int size() const{return computedRows>0 ? computedRows : column1.size();};
+    bool isEmpty() const{return size()==0;};
+
+    bool isColumn1Computed() const{return computedRows>0;};
+    double column1At(int row) const{
+        return computedRows>0 ? line.value(row) : column1.at(row);
+    };
+    ColumnSpan<double> column1Span() const{
+        if(computedRows>0)
+            return line.exactColumn(computedRows);
+        return ColumnSpan<double>(column1.constData(), column1.size());
+    };
+    // rows [first, last) of column1: a pointer into the column, or into
+    // buffer, with room for last-first values, if it is computed
+    const double *column1Rows(int first, int last, double *buffer) const{
+        if(computedRows==0)
+            return column1.constData()+first;
+        for(int i=first; i<last; i++)
+            buffer[i-first]=line.value(i);
+        return buffer;
     };
 
-    bool operator <(const RowData other) const{
-        return column1<other.column1;
+    bool isPacked(int series) const{
+        return series<packed.size() && !packed.at(series).isEmpty();
+    };
+    unsigned int count(int series, int row) const{
+        return isPacked(series) ? packed.at(series).at(row) : counts.at(series).at(row);
+    };
+    // rows [first, last) of a count column: a pointer into the column, or
+    // into buffer, with room for last-first values, if it is packed
+    const unsigned int *countRows(int series, int first, int last, unsigned int *buffer) const{
+        if(!isPacked(series))
+            return counts.at(series).constData()+first;
+        packed.at(series).decode(first, last, buffer);
+        return buffer;
+    };
+
+    QVector<double> column1;                   // empty while computed
+    QVector< QVector<unsigned int> > counts;   // empty while packed
+    QVector<CompressedCounts> packed;          // empty, or one per count column
+    UniformAxis line;                          // column1 while it is computed
+    int computedRows;                          // rows while column1 is computed, else 0
+};
+
+// Read-only view of a model's columns, index and header that can be used
+// on another thread. Taking one copies no rows: the arrays are shared and
+// the model detaches from them on its next change, so a snapshot stays
+// valid and unchanged for as long as it is kept.
+class TableSnapshot{
+public:
+    TableSnapshot() : sorted(true) {};
+
+    int rowCount() const{return data.size();};
+    int countColumnCount() const{return data.counts.size();};
+    ColumnSpan<double> column1() const{return data.column1Span();};
+    const double *column1Rows(int first, int last, double *buffer) const{
+        return data.column1Rows(first, last, buffer);
+    };
+    unsigned int count(int series, int row) const{return data.count(series, row);};
+    const unsigned int *countRows(int series, int first, int last, unsigned int *buffer) const{
+        return data.countRows(series, first, last, buffer);
     };
+    void countRange(int series, int first, int last, unsigned int &min, unsigned int &max) const;
+    bool isSorted() const{return sorted;};
+    // row lookups by column1 value for sorted data, see TableModel
+    int lowerBound(double value) const{return axis.lowerBound(column1(), value);};
+    int upperBound(double value) const{return axis.upperBound(column1(), value);};
+    int nearestRow(double value) const{return axis.nearestRow(column1(), value);};
+    const UniformAxis &column1Axis() const{return axis;};
+    // empty for a column without a header
+    QString header(int column) const{return headers.value(column);};
 
-    double column1;
-    unsigned int column2;
-    // so that default table delegate will check for valid inputs
+private:
+    friend class TableModel;
+
+    QStringList headers;
+    ColumnBlock data;
+    QVector<MinMaxPyramid> index;
+    UniformAxis axis;
+    bool sorted;
 };
 
 class TableModel : public QAbstractTableModel
@@ -28,7 +116,20 @@ public:
     explicit TableModel(QObject *parent = 0);
 
     bool loadFile(QTextStream &in);
+    bool loadFile(const QString &fileName);
+
+    // progressive loading, rows are appended as they are parsed
+    void beginLoading(const QStringList &header, int estimatedRows);
+    void appendRows(const ColumnBlock &rows);
+    void endLoading();
+
+    // rows read from a growing file or pasted, see mergeRows()
+    void mergeRows(const ColumnBlock &rows);
+    bool pasteRows(const QString &text);
+
     void saveFile(QTextStream &out);
+    bool saveFile(const QString &fileName);
+    bool saveBinaryFile(const QString &fileName);
 
     int rowCount(const QModelIndex &parent=QModelIndex()) const;
     int columnCount(const QModelIndex &parent=QModelIndex()) const;
@@ -40,12 +141,48 @@ public:
     QVariant getData(const int row, const int column) const
     {
         if(column==0)
-            return mData.at(row).column1;
-        else if(column==1)
-            return mData.at(row).column2;
+            return mData.column1At(row);
+        else if(column>0 && column<=mData.counts.size())
+            return mData.count(column-1, row);
         return QVariant::Invalid;
     };
 
+    // number of count channels, the columns after column1
+    int countColumnCount() const{return mData.counts.size();};
+
+    // direct read-only access to the columns, no copy and no QVariant;
+    // column1 may be computed, see ColumnSpan
+    ColumnSpan<double> column1() const{return mData.column1Span();};
+    unsigned int count(int series, int row) const{return mData.count(series, row);};
+    // rows [first, last) of a count column, see ColumnBlock::countRows()
+    const unsigned int *countRows(int series, int first, int last, unsigned int *buffer) const{
+        return mData.countRows(series, first, last, buffer);
+    };
+    const ColumnBlock &columns() const{return mData;};
+    // cheap copy of the current data for the render thread
+    TableSnapshot snapshot() const;
+
+    // smallest and largest column1 value, O(1)
+    void column1Range(double &min, double &max) const;
+    // Rows by column1 value, for sorted data: the first row at or above
+    // value, the first row above it and the closest row. O(1) when
+    // column1 is evenly spaced, a binary search otherwise.
+    int lowerBound(double value) const{return mAxis.lowerBound(column1(), value);};
+    int upperBound(double value) const{return mAxis.upperBound(column1(), value);};
+    int nearestRow(double value) const{return mAxis.nearestRow(column1(), value);};
+    // the energy calibration found in column1, if it has one
+    const UniformAxis &column1Axis() const{return mAxis;};
+    // min and max of a count column over rows [first, last) in O(log n)
+    void countRange(int series, int first, int last, unsigned int &min, unsigned int &max) const;
+
+    // Keep the count columns packed, which takes several times less memory
+    // for spectra with long quiet stretches. An edit unpacks the columns it
+    // touches; they are packed again when control returns to the event loop.
+    void setCompactCounts(bool on);
+    bool isCompactCounts() const{return mCompactCounts;};
+    // bytes held by the count columns
+    qint64 countsMemorySize() const;
+
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     bool setHeaderData(int section, Qt::Orientation orientation, const QVariant &value, int role);
 
@@ -54,26 +191,55 @@ public:
     bool insertRows(int row, int count, const QModelIndex &parent);
     bool removeRows(int row, int count, const QModelIndex &parent);
 
-    bool insert(const QModelIndex &parent){
-        return insertRows( parent.row(), 1, parent);
+    bool insert(const QModelIndex &index){
+        return insertRows( index.row(), 1, QModelIndex());
     };
-    bool remove(const QModelIndex &parent){
-        return removeRows( parent.row(), 1, parent);
+    bool remove(const QModelIndex &index){
+        return removeRows( index.row(), 1, QModelIndex());
     };
+    // the rows of a selection, in any order
+    bool removeRowSet(const QVector<int> &rows);
 
     bool isFileDataChanged() const{return fileDataChanged;};
+    // true when column1 is in ascending order, so it can be binary searched
+    bool isSorted() const{return mSorted;};
+    // rows whose column1 value equals the one before, as of the last sort
+    int duplicateCount() const{return mDuplicates;};
+    QString errorString() const{return mErrorString;};
 
 signals:
 
 public slots:
 
+private slots:
+    void packCounts();
+
 private:
-    void sortByColumn1();
+    void setColumns(const QStringList &header, ColumnBlock &rows);
+    bool sortByColumn1();
+    bool setColumn1Sorted(int row, double value);
+    void insertBlock(int position, const ColumnBlock &rows, const int *order, int count);
+    void updateIndex(int first, int last);
+    void updateIndex(int series, int first, int last);
+    void mergeColumn1Range(int first, int last);
+    void unpackCounts();
+    void unpackCounts(int series);
+    void dropColumn1();
+    void restoreColumn1();
 
     QStringList mHeader;
-    QList<RowData> mData;
+    // columnar storage, one contiguous array per column
+    ColumnBlock mData;
+    QVector<MinMaxPyramid> mCountsIndex;   // kept in sync on every change of the counts
+    UniformAxis mAxis;   // found when sorting, dropped by edits of column1
 
     bool fileDataChanged;
+    bool mSorted;
+    bool mCompactCounts;
+    bool mPackingScheduled;
+    int mDuplicates;
+    double mColumn1Min, mColumn1Max;   // tracked for unsorted data
+    QString mErrorString;
 };
 
 #endif // TABLEMODEL_H
@@ -0,0 +1,115 @@
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include "tracer.h"
+
+QAtomicInt Tracer::enabled(0);
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 start;
+    qint64 duration;
+    Qt::HANDLE thread;
+};
+
+static QMutex eventMutex;
+static QVector<TraceEvent> events;     // guarded by eventMutex
+
+static QElapsedTimer startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+static const QElapsedTimer &traceClock()
+{
+    static const QElapsedTimer clock = startedClock();
+    return clock;
+}
+
+void Tracer::setEnabled(bool on)
+{
+    traceClock();
+    enabled.store(on ? 1 : 0);
+}
+
+void Tracer::clear()
+{
+    QMutexLocker locker(&eventMutex);
+    events.clear();
+}
+
+int Tracer::eventCount()
+{
+    QMutexLocker locker(&eventMutex);
+    return events.size();
+}
+
+qint64 Tracer::now()
+{
+    return traceClock().nsecsElapsed();
+}
+
+void Tracer::addEvent(const char *name, qint64 start, qint64 duration)
+{
+    TraceEvent event;
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.thread = QThread::currentThreadId();
+
+    QMutexLocker locker(&eventMutex);
+    if (events.size() < maxEvents)
+        events.append(event);
+}
+
+// complete ("X") events in microseconds, threads numbered in order of
+// their first event
+bool Tracer::writeChromeTrace(const QString &fileName, QString &errorString)
+{
+    QVector<TraceEvent> copy;
+    {
+        QMutexLocker locker(&eventMutex);
+        copy = events;
+    }
+
+    QHash<Qt::HANDLE, int> threadIds;
+    QByteArray json;
+    json.reserve(copy.size() * 100 + 256);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (int i = 0; i < copy.size(); ++i)
+    {
+        const TraceEvent &event = copy.at(i);
+        if (!threadIds.contains(event.thread))
+        {
+            int id = threadIds.size() + 1;
+            threadIds.insert(event.thread, id);
+            json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(id)
+                    + ",\"args\":{\"name\":\"thread " + QByteArray::number(id) + "\"}},\n";
+        }
+        json += "{\"name\":\"";
+        json += event.name;
+        json += "\",\"cat\":\"dataviewer\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+        json += QByteArray::number(threadIds.value(event.thread));
+        json += ",\"ts\":";
+        json += QByteArray::number(event.start / 1e3, 'f', 3);
+        json += ",\"dur\":";
+        json += QByteArray::number(event.duration / 1e3, 'f', 3);
+        json += i + 1 < copy.size() ? "},\n" : "}\n";
+    }
+    json += "]}\n";
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+    {
+        errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QString>
+
+// Scoped timing of the hot paths, switched on at runtime and exported as
+// a Chrome trace (chrome://tracing, ui.perfetto.dev):
+//
+//     void TableModel::sortByColumn1()
+//     {
+//         TRACE_SCOPE("sortByColumn1");
+//         ...
+//
+// When tracing is off a scope costs one relaxed atomic load. Recorded
+// events are kept in memory, up to maxEvents, until cleared.
+class Tracer
+{
+public:
+    static bool isEnabled() { return enabled.load() != 0; };
+    static void setEnabled(bool on);
+    static void clear();
+    static int eventCount();
+
+    // nanoseconds on a monotonic clock shared by all threads
+    static qint64 now();
+    // name must be a string literal, only the pointer is kept
+    static void addEvent(const char *name, qint64 start, qint64 duration);
+
+    static bool writeChromeTrace(const QString &fileName, QString &errorString);
+
+    enum { maxEvents = 1000000 };
+
+private:
+    static QAtomicInt enabled;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) :
+        name(name), start(Tracer::isEnabled() ? Tracer::now() : -1) {};
+    ~TraceScope() {
+        if (start >= 0)
+            Tracer::addEvent(name, start, Tracer::now() - start);
+    };
+
+private:
+    const char *name;
+    qint64 start;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif // TRACER_H
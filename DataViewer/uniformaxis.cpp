@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cmath>
+
+#include "uniformaxis.h"
+
+// largest distance from the line, in steps
+static const double maxResidual = 0.25;
+
+// the line through the first and last row, kept if every row is close to it
+UniformAxis UniformAxis::detect(const ColumnSpan<double> &column)
+{
+    UniformAxis axis;
+    const int size = column.size();
+    if (size < 3)
+        return axis;
+    const double step = (column[size - 1] - column[0]) / (size - 1);
+    if (!(step > 0) || std::isinf(step))
+        return axis;
+
+    axis.mOffset = column[0];
+    axis.mStep = step;
+    if (!axis.extends(column, 1))
+        axis.mStep = 0;
+    else
+        axis.findExactLine(column);
+    return axis;
+}
+
+// true if every row of column is (offset + i * step) / divisor
+static bool isLine(const ColumnSpan<double> &column, int first, double offset, double step, double divisor)
+{
+    for (int i = 0; i < column.size(); ++i)
+    {
+        if ((offset + (first + i) * step) / divisor != column[i])
+            return false;
+    }
+    return true;
+}
+
+// Energies read from a file with d decimals are exactly (a + i * b) / 10^d
+// for whole numbers a and b below 2^53, as the parser divides exactly that
+// way. Computed energies are often i * step. Either is checked on every
+// row, as only an exact line can stand in for the column.
+bool UniformAxis::findExactLine(const ColumnSpan<double> &column)
+{
+    const int size = column.size();
+    const double limit = 9007199254740992.0;   // 2^53
+    double divisor = 1;
+    for (int decimals = 0; decimals <= 15; ++decimals, divisor *= 10)
+    {
+        const double first = std::floor(column[0] * divisor + 0.5);
+        const double last = std::floor(column[size - 1] * divisor + 0.5);
+        if (!(std::fabs(first) < limit && std::fabs(last) < limit))
+            break;
+        const double step = (last - first) / (size - 1);
+        if (step != std::floor(step) || first / divisor != column[0] || last / divisor != column[size - 1])
+            continue;
+        if (isLine(column, 0, first, step, divisor))
+        {
+            mExactOffset = first;
+            mExactStep = step;
+            mDivisor = divisor;
+            return true;
+        }
+    }
+    if (column[0] == 0 && isLine(column, 0, 0, column[1], 1))
+    {
+        mExactOffset = 0;
+        mExactStep = column[1];
+        mDivisor = 1;
+        return true;
+    }
+    return false;
+}
+
+bool UniformAxis::continuesExactly(const ColumnSpan<double> &values, int first) const
+{
+    return isExact() && isLine(values, first, mExactOffset, mExactStep, mDivisor);
+}
+
+bool UniformAxis::extends(const ColumnSpan<double> &column, int first) const
+{
+    if (!isUniform())
+        return false;
+    const double tolerance = maxResidual * mStep;
+    for (int i = first; i < column.size(); ++i)
+    {
+        // written so that a nan fails as well
+        if (!(std::fabs(column[i] - (mOffset + i * mStep)) <= tolerance))
+            return false;
+    }
+    return true;
+}
+
+int UniformAxis::estimate(double x, int size) const
+{
+    const double row = std::ceil((x - mOffset) / mStep);
+    if (!(row > 0))
+        return 0;
+    return row < size ? int(row) : size;
+}
+
+// The estimate is at most a row or two off, the column has the last word.
+int UniformAxis::lowerBound(const ColumnSpan<double> &column, double x) const
+{
+    if (!isUniform())
+        return std::lower_bound(column.begin(), column.end(), x) - column.begin();
+
+    const int size = column.size();
+    int row = estimate(x, size);
+    while (row > 0 && column[row - 1] >= x)
+        --row;
+    while (row < size && column[row] < x)
+        ++row;
+    return row;
+}
+
+int UniformAxis::upperBound(const ColumnSpan<double> &column, double x) const
+{
+    if (!isUniform())
+        return std::upper_bound(column.begin(), column.end(), x) - column.begin();
+
+    const int size = column.size();
+    int row = estimate(x, size);
+    while (row > 0 && column[row - 1] > x)
+        --row;
+    while (row < size && column[row] <= x)
+        ++row;
+    return row;
+}
+
+int UniformAxis::nearestRow(const ColumnSpan<double> &column, double x) const
+{
+    if (column.isEmpty())
+        return -1;
+    const int row = lowerBound(column, x);
+    if (row == column.size())
+        return row - 1;
+    if (row > 0 && x - column[row - 1] < column[row] - x)
+        return row - 1;
+    return row;
+}
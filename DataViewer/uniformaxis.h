@@ -0,0 +1,54 @@
+#ifndef UNIFORMAXIS_H
+#define UNIFORMAXIS_H
+
+#include "columnspan.h"
+
+// Line through column1 for spectra from an MCA with a linear energy
+// calibration, where row i is at about offset + i * step. detect() only
+// accepts a column that stays within a quarter step of the line, which
+// leaves room for the rounding of the energies in the file. The line then
+// points at the row for an energy and the column itself settles the last
+// step, so lookups are O(1). The default axis is not uniform, and the
+// lookups are a binary search over the column, which must be sorted.
+// detect() also looks for a line that gives every row of the column
+// exactly, see isExact(), so the model can compute it instead of storing it.
+class UniformAxis
+{
+public:
+    UniformAxis() : mOffset(0), mStep(0), mExactOffset(0), mExactStep(0), mDivisor(0) {};
+
+    static UniformAxis detect(const ColumnSpan<double> &column);
+    // true if rows [first, column.size()) are on the line as well
+    bool extends(const ColumnSpan<double> &column, int first) const;
+
+    bool isUniform() const { return mStep > 0; };
+    double offset() const { return mOffset; };
+    double step() const { return mStep; };
+
+    // true if value() is the column of detect() bit for bit
+    bool isExact() const { return mDivisor > 0; };
+    double value(int row) const { return (mExactOffset + row * mExactStep) / mDivisor; };
+    // rows [0, size) of the exact line
+    ColumnSpan<double> exactColumn(int size) const {
+        return ColumnSpan<double>(mExactOffset, mExactStep, mDivisor, size);
+    };
+    // true if values are rows first, first + 1, ... of the exact line
+    bool continuesExactly(const ColumnSpan<double> &values, int first) const;
+
+    // first row with a value >= x, column.size() if there is none
+    int lowerBound(const ColumnSpan<double> &column, double x) const;
+    // first row with a value > x
+    int upperBound(const ColumnSpan<double> &column, double x) const;
+    // row with the value closest to x, -1 for an empty column
+    int nearestRow(const ColumnSpan<double> &column, double x) const;
+
+private:
+    // row where the line reaches x, clamped to [0, size]
+    int estimate(double x, int size) const;
+    bool findExactLine(const ColumnSpan<double> &column);
+
+    double mOffset, mStep;
+    double mExactOffset, mExactStep, mDivisor;   // no exact line while mDivisor is 0
+};
+
+#endif // UNIFORMAXIS_H
@@ -0,0 +1,16 @@
+#ifndef WORKERTHREAD_H
+#define WORKERTHREAD_H
+
+#include <QCoreApplication>
+#include <QThread>
+
+// True on any thread but the one of the application. Work that would be
+// spread over a thread pool is done serially there: in batch mode such a
+// thread is already one job of a pool with a thread per core.
+inline bool isWorkerThread()
+{
+    QCoreApplication *application = QCoreApplication::instance();
+    return application != NULL && QThread::currentThread() != application->thread();
+}
+
+#endif // WORKERTHREAD_H